@@ -0,0 +1,39 @@
+#!/bin/sh
+# Checks that uarch-bisect takes a root stream whose first root starts with
+# '{' (0x7b) as a root stream and not as a step log. The simple log with the
+# last RAM word, which no step touches, set to 161 has such a first root; the
+# verifier's stream is its roots with the last one changed, so the bisection
+# has to end on the last step and mpc_main has to accept the prover's step.
+#
+# ./bisect-roots-test.sh [gcc flags, e.g. -D RV64I_MERKLE]
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+gcc -O2 -o "$dir/uarch-roots" uarch-roots.c
+gcc -O2 "$@" -o "$dir/uarch-bisect" uarch-bisect.c
+
+sed 's/^\(    "circuit_ram" : "[0-9a-f]*\)[0-9a-f]\{16\}"/\100000000000000a1"/' rv64ui-uarch-simple-steps.json > "$dir/steps.json"
+"$dir/uarch-roots" -b "$dir/steps.json" > "$dir/steps.roots" 2> /dev/null
+first=$(head -c 1 "$dir/steps.roots" | od -An -tx1 | tr -d ' ')
+if [ "$first" != 7b ]; then
+    echo "FAIL: the first root starts with $first, not 7b"
+    exit 1
+fi
+cp "$dir/steps.roots" "$dir/verifier.roots"
+size=$(wc -c < "$dir/verifier.roots")
+printf '\377' | dd of="$dir/verifier.roots" bs=1 seek=$((size - 32)) conv=notrunc 2> /dev/null
+
+if ! "$dir/uarch-bisect" -o "$dir/input.bin" "$dir/steps.json" "$dir/verifier.roots" 2> "$dir/log" ||
+    ! grep -q "disputed step: cycle 11 " "$dir/log" || ! grep -q "mpc_main returns 0" "$dir/log"; then
+    cat "$dir/log"
+    echo "FAIL: root stream starting with 0x7b"
+    exit 1
+fi
+# a stream that is not whole roots is rejected as such
+head -c 40 "$dir/steps.roots" > "$dir/short.roots"
+if "$dir/uarch-bisect" "$dir/steps.json" "$dir/short.roots" 2> "$dir/log" || ! grep -q "not a stream of 32-byte roots" "$dir/log"; then
+    cat "$dir/log"
+    echo "FAIL: 40-byte root stream"
+    exit 1
+fi
+echo PASS
@@ -0,0 +1,297 @@
+// Reader for Bristol circuits, as circuit-utils --as-bristol and
+// keccak-bristol.js write them.
+//
+// "gates wires", then "inputs_a inputs_b outputs", then one gate per line:
+// "2 1 a b out AND|XOR|OR" or "1 1 a out INV". The inputs are wires
+// 0 .. inputs_a + inputs_b - 1 and the outputs the last wires. The file is
+// memory mapped and parsed in one pass into arrays.
+//
+// bristol_write saves the parsed arrays as a binary circuit, which
+// bristol_load maps and uses in place instead of parsing it, little endian:
+//
+//   struct BristolBinaryHeader
+//   uint8 op[gates], padded to a multiple of 8 bytes
+//   uint32 in0[gates], in1[gates], out[gates], each padded to 8 bytes
+
+#ifndef BRISTOL_H
+#define BRISTOL_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BRISTOL_AND 0
+#define BRISTOL_XOR 1
+#define BRISTOL_OR 2
+#define BRISTOL_INV 3
+
+#define BRISTOL_BINARY_MAGIC "RVBRIS01"
+
+struct BristolBinaryHeader {
+    char magic[8];
+    uint32_t gates;
+    uint32_t wires;
+    uint32_t inputs;
+    uint32_t outputs;
+    uint32_t and_gates;
+    uint32_t reserved;
+};
+
+struct BristolCircuit {
+    uint32_t gates;
+    uint32_t wires;
+    uint32_t inputs;        // inputs_a + inputs_b
+    uint32_t outputs;
+    uint32_t and_gates;     // AND and OR, the gates that are not free to garble
+    uint8_t *op;
+    uint32_t *in0;
+    uint32_t *in1;          // unused for INV
+    uint32_t *out;
+    void *map;              // a binary circuit: the arrays point into this mapping
+    size_t map_size;
+};
+
+static const char *bristol_number(const char *p, const char *end, uint32_t *value) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    uint64_t v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        v = v * 10 + (*p - '0');
+        if (v > UINT32_MAX) {
+            return NULL;
+        }
+    }
+    *value = (uint32_t)v;
+    return p;
+}
+
+static void bristol_free(struct BristolCircuit *c) {
+    if (c->map != NULL) {
+        munmap(c->map, c->map_size);
+    } else {
+        free(c->op);
+        free(c->in0);
+        free(c->in1);
+        free(c->out);
+    }
+    memset(c, 0, sizeof(*c));
+}
+
+static inline size_t bristol_pad8(size_t n) {
+    return (n + 7) / 8 * 8;
+}
+
+/// \brief Maps the binary circuit data, size bytes, in place; returns 0, or -1 with a message on stderr
+static int bristol_map(struct BristolCircuit *c, const char *path, void *data, size_t size) {
+    const struct BristolBinaryHeader *h = data;
+    size_t op_bytes = bristol_pad8(h->gates), wire_bytes = bristol_pad8((size_t)h->gates * sizeof(uint32_t));
+    if (size < sizeof(*h) + op_bytes + 3 * wire_bytes || h->inputs > h->wires || h->outputs > h->wires) {
+        fprintf(stderr, "%s: inconsistent binary circuit\n", path);
+        munmap(data, size);
+        return -1;
+    }
+    uint8_t *p = (uint8_t *)data + sizeof(*h);
+    c->gates = h->gates;
+    c->wires = h->wires;
+    c->inputs = h->inputs;
+    c->outputs = h->outputs;
+    c->and_gates = h->and_gates;
+    c->op = p;
+    c->in0 = (uint32_t *)(p + op_bytes);
+    c->in1 = (uint32_t *)(p + op_bytes + wire_bytes);
+    c->out = (uint32_t *)(p + op_bytes + 2 * wire_bytes);
+    c->map = data;
+    c->map_size = size;
+    // one pass over the gates instead of a parse: the evaluators do not check the wires
+    for (uint32_t g = 0; g < c->gates; g++) {
+        if (c->op[g] > BRISTOL_INV || c->in0[g] >= c->wires || c->in1[g] >= c->wires || c->out[g] >= c->wires) {
+            fprintf(stderr, "%s: bad gate %u\n", path, g);
+            bristol_free(c);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/// \brief Parses the circuit in path, or maps it if it is a binary circuit;
+/// returns 0, or -1 with a message on stderr
+static int bristol_load(struct BristolCircuit *c, const char *path) {
+    memset(c, 0, sizeof(*c));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    if ((size_t)st.st_size >= sizeof(struct BristolBinaryHeader) &&
+        memcmp(data, BRISTOL_BINARY_MAGIC, 8) == 0) {
+        return bristol_map(c, path, (void *)data, st.st_size);
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+    const char *p = data, *end = data + st.st_size;
+    uint32_t inputs_a, inputs_b;
+    int ret = -1;
+    if ((p = bristol_number(p, end, &c->gates)) == NULL || (p = bristol_number(p, end, &c->wires)) == NULL ||
+        (p = bristol_number(p, end, &inputs_a)) == NULL || (p = bristol_number(p, end, &inputs_b)) == NULL ||
+        (p = bristol_number(p, end, &c->outputs)) == NULL) {
+        fprintf(stderr, "%s: bad header\n", path);
+        goto out;
+    }
+    c->inputs = inputs_a + inputs_b;
+    if (c->inputs > c->wires || c->outputs > c->wires) {
+        fprintf(stderr, "%s: more inputs or outputs than wires\n", path);
+        goto out;
+    }
+    c->op = malloc(c->gates);
+    c->in0 = malloc(c->gates * sizeof(uint32_t));
+    c->in1 = malloc(c->gates * sizeof(uint32_t));
+    c->out = malloc(c->gates * sizeof(uint32_t));
+    for (uint32_t g = 0; g < c->gates; g++) {
+        uint32_t n_in, n_out;
+        if ((p = bristol_number(p, end, &n_in)) == NULL || (p = bristol_number(p, end, &n_out)) == NULL ||
+            n_out != 1 || (n_in != 1 && n_in != 2) ||
+            (p = bristol_number(p, end, &c->in0[g])) == NULL ||
+            (n_in == 2 && (p = bristol_number(p, end, &c->in1[g])) == NULL) ||
+            (p = bristol_number(p, end, &c->out[g])) == NULL) {
+            fprintf(stderr, "%s: bad gate %u\n", path, g);
+            goto out;
+        }
+        while (p < end && *p == ' ') {
+            p++;
+        }
+        size_t len = 0;
+        while (p + len < end && p[len] >= 'A' && p[len] <= 'Z') {
+            len++;
+        }
+        if (n_in == 2 && len == 3 && memcmp(p, "AND", 3) == 0) {
+            c->op[g] = BRISTOL_AND;
+        } else if (n_in == 2 && len == 3 && memcmp(p, "XOR", 3) == 0) {
+            c->op[g] = BRISTOL_XOR;
+        } else if (n_in == 2 && len == 2 && memcmp(p, "OR", 2) == 0) {
+            c->op[g] = BRISTOL_OR;
+        } else if (n_in == 1 && len == 3 && memcmp(p, "INV", 3) == 0) {
+            c->op[g] = BRISTOL_INV;
+            c->in1[g] = c->in0[g];
+        } else {
+            fprintf(stderr, "%s: unsupported gate %u (%.*s)\n", path, g, (int)len, p);
+            goto out;
+        }
+        p += len;
+        if (c->in0[g] >= c->wires || c->in1[g] >= c->wires || c->out[g] >= c->wires) {
+            fprintf(stderr, "%s: gate %u uses a wire beyond %u\n", path, g, c->wires);
+            goto out;
+        }
+        if (c->op[g] == BRISTOL_AND || c->op[g] == BRISTOL_OR) {
+            c->and_gates++;
+        }
+    }
+    ret = 0;
+out:
+    munmap((void *)data, st.st_size);
+    if (ret != 0) {
+        bristol_free(c);
+    }
+    return ret;
+}
+
+/// \brief Writes the circuit to path as a binary circuit; returns 0, or -1 with a message on stderr
+static inline int bristol_write(const struct BristolCircuit *c, const char *path) {
+    static const uint8_t zero[8];
+    struct BristolBinaryHeader h = { BRISTOL_BINARY_MAGIC, c->gates, c->wires, c->inputs, c->outputs, c->and_gates, 0 };
+    size_t wire_bytes = (size_t)c->gates * sizeof(uint32_t);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(c->op, 1, c->gates, f);
+    fwrite(zero, 1, bristol_pad8(c->gates) - c->gates, f);
+    const uint32_t *arrays[3] = { c->in0, c->in1, c->out };
+    for (int i = 0; i < 3; i++) {
+        fwrite(arrays[i], 1, wire_bytes, f);
+        fwrite(zero, 1, bristol_pad8(wire_bytes) - wire_bytes, f);
+    }
+    int failed = ferror(f) != 0;
+    if (fclose(f) != 0 || failed) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/// \brief Evaluates the circuit on w, one byte (0 or 1) per wire, with the inputs already set
+static inline void bristol_eval(const struct BristolCircuit *c, uint8_t *w) {
+    for (uint32_t g = 0; g < c->gates; g++) {
+        uint8_t a = w[c->in0[g]], b = w[c->in1[g]];
+        switch (c->op[g]) {
+        case BRISTOL_AND: w[c->out[g]] = a & b; break;
+        case BRISTOL_XOR: w[c->out[g]] = a ^ b; break;
+        case BRISTOL_OR: w[c->out[g]] = a | b; break;
+        default: w[c->out[g]] = a ^ 1; break;
+        }
+    }
+}
+
+/// \brief Evaluates the circuit on 64 inputs at once: bit k of w[i] is wire i of input k
+static inline void bristol_eval_sliced(const struct BristolCircuit *c, uint64_t *w) {
+    for (uint32_t g = 0; g < c->gates; g++) {
+        uint64_t a = w[c->in0[g]], b = w[c->in1[g]];
+        switch (c->op[g]) {
+        case BRISTOL_AND: w[c->out[g]] = a & b; break;
+        case BRISTOL_XOR: w[c->out[g]] = a ^ b; break;
+        case BRISTOL_OR: w[c->out[g]] = a | b; break;
+        default: w[c->out[g]] = ~a; break;
+        }
+    }
+}
+
+/// \brief Sets the inputs of lane k of w to bits, the input bits LSB first and
+/// padded to whole 64-bit words; the lane's inputs have to be 0 before
+static inline void bristol_set_lane(const struct BristolCircuit *c, uint64_t *w, unsigned k, const uint8_t *bits) {
+    for (uint32_t i = 0; i < c->inputs; i += 64) {
+        uint64_t word;
+        memcpy(&word, bits + i / 8, sizeof(word));
+        if (c->inputs - i < 64) {
+            word &= ((uint64_t)1 << (c->inputs - i)) - 1;
+        }
+        for (; word != 0; word &= word - 1) {
+            w[i + __builtin_ctzll(word)] |= (uint64_t)1 << k;
+        }
+    }
+}
+
+/// \brief The outputs of lane k of w after bristol_eval_sliced, LSB first and
+/// sign extended, the first 64 of them
+static inline int64_t bristol_lane_output(const struct BristolCircuit *c, const uint64_t *w, unsigned k) {
+    uint32_t first_out = c->wires - c->outputs;
+    uint32_t out_bits = c->outputs < 64 ? c->outputs : 64;
+    uint64_t v = 0;
+    for (uint32_t o = 0; o < out_bits; o++) {
+        v |= ((w[first_out + o] >> k) & 1) << o;
+    }
+    if (out_bits < 64 && (v >> (out_bits - 1)) & 1) {
+        v |= ~(uint64_t)0 << out_bits;
+    }
+    return (int64_t)v;
+}
+
+#endif
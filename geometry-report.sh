@@ -0,0 +1,79 @@
+#!/bin/sh
+# Reports how mpc_main scales with the RAM geometry: for every RAM_WORD_BITS
+# given, the StandardRAM size and the AND gates that grow with it, derived
+# from rv64i.c (free XOR, a 2:1 mux is 1 AND per bit, a 64-bit equality 63):
+#   access    access_and_compare_sparse: a (words - 1) x 64 mux per logged
+#             read and last write of a non-fixed slot, plus per word the
+#             check that it is untouched or unchanged. Linear in the words.
+#   snapshot  the two snapshot compares, plus without BISECTION_SCHEDULE_PUBLIC
+#             the two data-dependent selections out of the prover's snapshots.
+# The rest of the step circuit does not depend on the geometry. The derived
+# columns assume StandardRAM snapshots and are left out for RV64I_MERKLE.
+# With cbmc-gc ($HYCC, ~/HyCC/bin by default) it also builds mpc_main and
+# prints the circuit input bits and the gate counts of the Bristol export;
+# without it those columns are "-". Flags after -- are passed to cbmc-gc,
+# e.g. a variant or a RAM_WINDOWS list, and the derived counts follow
+# BISECTION_SCHEDULE_PUBLIC, DISSECTION_ARITY and INSN_CLASS among them.
+#
+# ./geometry-report.sh 10 11 12
+# ./geometry-report.sh 10 12 -- -D BISECTION_SCHEDULE_PUBLIC
+# ./geometry-report.sh 11 -- -D 'RAM_WINDOWS={{0x70000000,0x1000},{0x80000000,0x2c00}}'
+set -e
+HYCC=${HYCC:-$HOME/HyCC/bin}
+bits=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    bits="$bits $1"
+    shift
+done
+[ "$1" = "--" ] && shift
+
+# has to match ACCESS_LOG_SIZE, BISECTION_STEPS and SANITY_FIRST_WRITE_SLOT in rv64i.c
+slots=16
+arity=2
+public=0
+merkle=0
+for arg in "$@"; do
+    case $arg in
+        *BISECTION_SCHEDULE_PUBLIC*) public=1 ;;
+        *RV64I_MERKLE*) merkle=1 ;;
+        *DISSECTION_ARITY=*) arity=${arg##*DISSECTION_ARITY=} ;;
+        *INSN_CLASS=INSN_CLASS_ALU | *INSN_CLASS=INSN_CLASS_LOAD) slots=10 ;;
+        *INSN_CLASS=INSN_CLASS_STORE) slots=11 ;;
+        *INSN_CLASS=INSN_CLASS_BRANCH | *INSN_CLASS=INSN_CLASS_JUMP) slots=9 ;;
+    esac
+done
+case $arity in
+    2) rounds=30 ;; 4) rounds=15 ;; 8) rounds=10 ;; 16) rounds=8 ;; 32) rounds=6 ;; 64) rounds=5 ;;
+    *) echo "DISSECTION_ARITY=$arity is not one rv64i.c supports" >&2; exit 1 ;;
+esac
+reads=$((slots - 3))
+writes=$((slots - 4))
+snapshots=$((rounds * (arity - 1)))
+
+printf "%-5s %-10s %-10s %-10s %-10s %-10s %-10s %-10s %-10s\n" bits ram_bytes access snapshot inputs gates AND XOR OR
+for b in $bits; do
+    words=$((1 << b))
+    if [ $merkle = 1 ]; then
+        access=-
+        snapshot=-
+    else
+        access=$(((reads + writes) * ((words - 1) * 64 + 63) + words * (writes * (b + 1) + 65)))
+        snapshot=$((2 * words * 64 + (1 - public) * 2 * (snapshots - 1) * words * 64))
+    fi
+    inputs=- gates=- and=- xor=- or=-
+    if [ -x "$HYCC/cbmc-gc" ]; then
+        dir=geometry-$b
+        mkdir -p $dir
+        ( cd $dir && "$HYCC/cbmc-gc" ../rv64i.c -D RAM_WORD_BITS=$b "$@" --minimization-time-limit 120 --bool mpc_main > build.log 2>&1 &&
+            "$HYCC/circuit-utils" mpc_main.circ --as-bristol bristol_circuit.txt >> build.log 2>&1 ) || {
+            echo "build for RAM_WORD_BITS=$b failed, see $dir/build.log" >&2
+            exit 1
+        }
+        gates=$(head -1 $dir/bristol_circuit.txt | cut -d' ' -f1)
+        inputs=$(sed -n 2p $dir/bristol_circuit.txt | awk '{ print $1 + $2 }')
+        and=$(grep -c ' AND$' $dir/bristol_circuit.txt || true)
+        xor=$(grep -c ' XOR$' $dir/bristol_circuit.txt || true)
+        or=$(grep -c ' OR$' $dir/bristol_circuit.txt || true)
+    fi
+    printf "%-5s %-10s %-10s %-10s %-10s %-10s %-10s %-10s %-10s\n" $b $((8 << b)) $access $snapshot $inputs $gates $and $xor $or
+done
@@ -0,0 +1,129 @@
+// Field layout of the circuit inputs.
+//
+// Include after rv64i.c. Describes, for the -D flags of this build, the
+// struct mpc_main takes (BisectInput, PackedBisectInput or MerkleBisectInput)
+// and the one the step circuit takes (Input for rv64i, PackedInput for
+// rv64i_packed), field by field in declaration order. That is the order of
+// the input bits of the circuits, every element LSB first, and of the binary
+// inputs the native tools write: the fields back to back, little endian,
+// without padding. Field names are the ones the .spec files use.
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct LayoutField {
+    const char *name;
+    size_t offset;          // in the C struct
+    uint32 elem_bytes;
+    uint32 count;           // elements, nested arrays flattened
+    bool is_signed;
+};
+
+struct InputLayout {
+    const char *name;
+    const struct LayoutField *fields;
+    uint32 field_count;
+};
+
+// signed if -1 stays below 1 (against 0, unsigned types warn under -Wtype-limits)
+#define LAYOUT_FIELD(T, f, elem) \
+    { #f, offsetof(T, f), sizeof(elem), sizeof(((T *)0)->f) / sizeof(elem), (elem)-1 < (elem)1 }
+#define LAYOUT(name, fields) { name, fields, sizeof(fields) / sizeof(fields[0]) }
+
+#if defined(RV64I_PACKED_INPUT)
+typedef struct PackedBisectInput MpcInput;
+typedef struct PackedInput StepInput;
+
+static const struct LayoutField mpc_input_fields[] = {
+    LAYOUT_FIELD(MpcInput, ram, uint64),
+    LAYOUT_FIELD(MpcInput, ram_disagree, uint64),
+    LAYOUT_FIELD(MpcInput, prover_bisection_RAM, uint64),
+    LAYOUT_FIELD(MpcInput, access_slot, uint16),
+    LAYOUT_FIELD(MpcInput, access_val, uint64),
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    LAYOUT_FIELD(MpcInput, verifier_bisections, uint32),
+#endif
+};
+
+static const struct LayoutField step_input_fields[] = {
+    LAYOUT_FIELD(StepInput, access_slot, uint16),
+    LAYOUT_FIELD(StepInput, access_val, uint64),
+};
+#else
+#if defined(RV64I_MERKLE)
+typedef struct MerkleBisectInput MpcInput;
+
+static const struct LayoutField mpc_input_fields[] = {
+    LAYOUT_FIELD(MpcInput, root, uint8),
+    LAYOUT_FIELD(MpcInput, root_disagree, uint8),
+    LAYOUT_FIELD(MpcInput, prover_bisection_root, uint8),
+    LAYOUT_FIELD(MpcInput, access_paddr, uint64),
+    LAYOUT_FIELD(MpcInput, access_val, uint64),
+    LAYOUT_FIELD(MpcInput, access_readWriteEnd, uint8),
+    LAYOUT_FIELD(MpcInput, access_prev_val, uint64),
+    LAYOUT_FIELD(MpcInput, access_siblings, uint8),
+#else
+typedef struct BisectInput MpcInput;
+
+static const struct LayoutField mpc_input_fields[] = {
+    LAYOUT_FIELD(MpcInput, ram, uint64),
+    LAYOUT_FIELD(MpcInput, ram_disagree, uint64),
+    LAYOUT_FIELD(MpcInput, prover_bisection_RAM, uint64),
+    LAYOUT_FIELD(MpcInput, access_paddr, uint64),
+    LAYOUT_FIELD(MpcInput, access_val, uint64),
+    LAYOUT_FIELD(MpcInput, access_readWriteEnd, uint8),
+#endif
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    LAYOUT_FIELD(MpcInput, verifier_bisections, uint8),
+#endif
+    LAYOUT_FIELD(MpcInput, pad, uint16),
+};
+
+typedef struct Input StepInput;
+
+static const struct LayoutField step_input_fields[] = {
+    LAYOUT_FIELD(StepInput, access_paddr, uint64),
+    LAYOUT_FIELD(StepInput, access_val, uint64),
+    LAYOUT_FIELD(StepInput, access_readWriteEnd, uint8),
+};
+#endif
+
+static const struct InputLayout mpc_input_layout = LAYOUT("mpc_main", mpc_input_fields);
+static const struct InputLayout step_input_layout = LAYOUT("rv64i", step_input_fields);
+
+#undef LAYOUT
+#undef LAYOUT_FIELD
+
+/// \brief Bytes of the packed layout, the sum of its fields
+static inline size_t layout_size(const struct InputLayout *l) {
+    size_t size = 0;
+    for (uint32 i = 0; i < l->field_count; i++) {
+        size += (size_t)l->fields[i].elem_bytes * l->fields[i].count;
+    }
+    return size;
+}
+
+/// \brief Writes the fields of the struct at in back to back
+static inline void layout_write(FILE *out, const struct InputLayout *l, const void *in) {
+    for (uint32 i = 0; i < l->field_count; i++) {
+        fwrite((const uint8 *)in + l->fields[i].offset, l->fields[i].elem_bytes, l->fields[i].count, out);
+    }
+}
+
+/// \brief Copies the fields of the struct at in back to back into out, layout_size bytes
+static inline void layout_pack(const struct InputLayout *l, const void *in, uint8 *out) {
+    for (uint32 i = 0; i < l->field_count; i++) {
+        size_t n = (size_t)l->fields[i].elem_bytes * l->fields[i].count;
+        memcpy(out, (const uint8 *)in + l->fields[i].offset, n);
+        out += n;
+    }
+}
+
+/// \brief Inverse of layout_pack: copies the fields back to back in in into the struct at out
+static inline void layout_unpack(const struct InputLayout *l, const uint8 *in, void *out) {
+    for (uint32 i = 0; i < l->field_count; i++) {
+        size_t n = (size_t)l->fields[i].elem_bytes * l->fields[i].count;
+        memcpy((uint8 *)out + l->fields[i].offset, in, n);
+        in += n;
+    }
+}
@@ -2,6 +2,109 @@ const fs = require("fs");
 const process = require("process");
 
 const steps = JSON.parse(fs.readFileSync(process.argv[2])).steps;
+// --class: emit the input for the per-instruction-class step circuit
+const perClass = process.argv.includes("--class");
+// --packed: emit the packed layout for rv64i.c built with -D RV64I_PACKED_INPUT
+const packedInput = process.argv.includes("--packed");
+// --merkle: emit Merkle roots and access paths for rv64i.c built with -D RV64I_MERKLE
+const merkleInput = process.argv.includes("--merkle");
+// --public: emit only the two snapshots the bisection ends on, for -D BISECTION_SCHEDULE_PUBLIC
+const publicSchedule = process.argv.includes("--public");
+// --wrong-snapshot: one word of the agreed prover snapshot differs from ram; mpc_main has to reject it
+const wrongSnapshot = process.argv.includes("--wrong-snapshot");
+// --arity k: k-ary dissection, for -D DISSECTION_ARITY=k
+const dissectionArity = option("--arity") !== undefined ? Number(option("--arity")) : 2;
+
+function option(name) {
+    const i = process.argv.indexOf(name);
+    return i < 0 ? undefined : process.argv[i + 1];
+}
+
+// RAM geometry, has to match RAM_WORD_BITS/PAGE_SIZE/RAM_WINDOWS in rv64i.c. The word
+// count follows the log's circuit_ram unless --ram-word-bits pads it to a larger
+// StandardRAM; --ram-windows takes start:size pairs, e.g. 0x70000000:0x1000,0x80000000:0x2000
+const PAGE_SIZE = 1024;
+const RAM_START = 0x70000000;
+const ramWordBits = option("--ram-word-bits") !== undefined ? Number(option("--ram-word-bits")) : Math.log2(Buffer.from(steps[0].circuit_ram, "hex").length / 8);
+if (!Number.isInteger(ramWordBits) || ramWordBits < 3) {
+    throw "bad RAM geometry, circuit_ram must be a power of two of at least 64 bytes";
+}
+const RAM_SIZE = 8 * 2 ** ramWordBits;
+const RAM_WORDS = RAM_SIZE / 8;
+const ramWindows = option("--ram-windows") !== undefined ?
+    option("--ram-windows").split(",").map(w => w.split(":").map(Number)).map(([start, size]) => ({ start, size })) :
+    [{ start: RAM_START, size: RAM_SIZE - PAGE_SIZE }];
+if (PAGE_SIZE + ramWindows.reduce((sum, w) => sum + w.size, 0) > RAM_SIZE) {
+    throw "RAM windows do not fit in " + RAM_SIZE + " bytes";
+}
+const defaultGeometry = ramWordBits == 10 && option("--ram-windows") === undefined;
+
+function ramContains(paddr) {
+    return paddr < PAGE_SIZE || ramWindows.some(w => paddr >= w.start && paddr < w.start + w.size);
+}
+
+// has to match ramOffset in rv64i.c
+function ramOffset(paddr) {
+    let off = paddr;
+    let base = PAGE_SIZE;
+    for (const w of ramWindows) {
+        if (paddr >= w.start && paddr < w.start + w.size) {
+            off = paddr - w.start + base;
+        }
+        base += w.size;
+    }
+    return off;
+}
+
+function ramWord(paddr) {
+    return Math.floor(ramOffset(paddr) / 8);
+}
+
+// circuit_ram comes in the emulator's layout, the page followed by one window at
+// RAM_START; move every word to its place in the configured geometry
+function readRAM(hex) {
+    const ram = Buffer.from(hex, "hex");
+    if (ram.length < PAGE_SIZE || ram.length % 8 != 0) {
+        throw "bad " + ram.length;
+    }
+    const words = Array(RAM_WORDS).fill("0x0");
+    for (let j = 0; j < ram.length / 8; j++) {
+        const paddr = j * 8 < PAGE_SIZE ? j * 8 : j * 8 - PAGE_SIZE + RAM_START;
+        const val = ram.readBigUint64LE(j*8);
+        if (ramContains(paddr)) {
+            words[ramWord(paddr)] = "0x" + val.toString(16);
+        } else if (val != 0n) {
+            throw "circuit_ram word at 0x" + paddr.toString(16) + " is outside the RAM windows";
+        }
+    }
+    return words;
+}
+
+// has to match INSN_CLASS_* and ACCESS_LOG_SIZE in rv64i.c
+const INSN_CLASSES = [
+    { name: "all", logSize: 16 },
+    { name: "alu", logSize: 10 },
+    { name: "branch", logSize: 9 },
+    { name: "load", logSize: 10 },
+    { name: "store", logSize: 11 },
+    { name: "jump", logSize: 9 },
+];
+
+function insnClass(insn) {
+    switch (insn & 0x7f) {
+    case 0x13: case 0x1b: case 0x33: case 0x3b: case 0x37: case 0x17: case 0xf:
+        return 1;
+    case 0x63:
+        return 2;
+    case 0x3:
+        return 3;
+    case 0x23:
+        return 4;
+    case 0x6f: case 0x67:
+        return 5;
+    }
+    return 0;
+}
 
 var stepsOut = Array(steps.length).fill({});
 
@@ -11,18 +114,11 @@ for (var i = 0; i < steps.length; i++) {
     stepsOut[i].access_val = Array(16).fill(0);
     stepsOut[i].access_readWriteEnd = Array(16).fill(0);
     
-    var ram_page_orig = Buffer.from(steps[i].circuit_ram, "hex");
-    if (ram_page_orig.length != 8192) {
-        throw "bad " + ram_page_orig.length;
-    }
-    stepsOut[i].ram = Array(1024).fill(0);
-    for (var j = 0; j < 1024; j++) {
-        stepsOut[i].ram[j] = "0x" + ram_page_orig.readBigUint64LE(j*8).toString(16);
-    }
+    stepsOut[i].ram = readRAM(steps[i].circuit_ram);
     if (i > 0) {
 //        console.log(JSON.stringify(stepsOut[i-1].ram_after));
 //        console.log(JSON.stringify(stepsOut[i].ram));
-        for (var j = 0; j < 1024; j++) {
+        for (var j = 0; j < RAM_WORDS; j++) {
            if (stepsOut[i-1].ram_after[j] !== stepsOut[i].ram[j]) {
                console.log("access log mismatch " + j);
            }
@@ -33,32 +129,15 @@ for (var i = 0; i < steps.length; i++) {
         stepsOut[i].access_readWriteEnd[j] = steps[i].accesses[j].type == "read" ? 0 : 1;
         stepsOut[i].access_val[j] = "0x" + Buffer.from(steps[i].accesses[j].value, "hex").readBigUInt64LE(0).toString(16);
     }
-    if (stepsOut[i].ram.length > 8192/8) {
-           console.log("too long");
-           process.exit(1);
-    }
-
-    var ram_page_after_orig = Buffer.from(steps[i].circuit_ram, "hex");
-    if (ram_page_after_orig.length != 8192) {
-        throw "bad " + ram_page_after_orig.length;
-    }
-    stepsOut[i].ram_after = Array(1024).fill(0);
-    for (var j = 0; j < 1024; j++) {
-        stepsOut[i].ram_after[j] = "0x" + ram_page_after_orig.readBigUint64LE(j*8).toString(16);
-    }
+    stepsOut[i].ram_after = readRAM(steps[i].circuit_ram);
     
     for (var j = 0; j < steps[i].accesses.length; j++) {
         let paddr = stepsOut[i].access_paddr[j];
         if (stepsOut[i].access_readWriteEnd[j] == 1) {
-             if (paddr < 1024) {
-                   stepsOut[i].ram_after[paddr / 8] = stepsOut[i].access_val[j];
-             } else {
-               let off = paddr - 0x70000000 + 1024;
-               if (off / 8 > 1024) {
-                   throw "out of range write 0x" + paddr.toString("hex");
-               }
-               stepsOut[i].ram_page_after[off / 8] = stepsOut[i].access_val[j];
+             if (!ramContains(paddr)) {
+                 throw "out of range write 0x" + paddr.toString(16);
              }
+             stepsOut[i].ram_after[ramWord(paddr)] = stepsOut[i].access_val[j];
         }
     }
     stepsOut[i].access_readWriteEnd[steps[i].accesses.length] = 2;
@@ -72,7 +151,7 @@ for (var i = 0; i < steps.length; i++) {
 
 for (let step = 0; step < stepsOut.length; step++) {
     if (step > 0) {
-        for (var j = 0; j < 1024; j++) {
+        for (var j = 0; j < RAM_WORDS; j++) {
            if (stepsOut[step-1].ram_after[j] !== stepsOut[step].ram[j]) {
                console.log("access log mismatch " + j +  " " + stepsOut[step-1].ram_after[j] + " " +  stepsOut[step].ram[j]);
            }
@@ -82,52 +161,67 @@ for (let step = 0; step < stepsOut.length; step++) {
 //console.log("consistency check done");
 
 const MAX_CYCLE = 1024*1024*1024;
-const BISECTION_STEPS = 30;
+// has to match DISSECTION_ARITY in rv64i.c: --arity k commits k - 1 states per round
+const DISSECTION_ROUNDS = { 2: 30, 4: 15, 8: 10, 16: 8, 32: 6, 64: 5 };
+if (!(dissectionArity in DISSECTION_ROUNDS)) {
+    throw "unsupported arity " + dissectionArity;
+}
+const BISECTION_STEPS = DISSECTION_ROUNDS[dissectionArity];
+const DISSECTION_POINTS = dissectionArity - 1;
+const DISSECTION_RIGHT = option("--arity") !== undefined ? MAX_CYCLE - 2 : MAX_CYCLE;
+
+// has to match dissectionPoint in rv64i.c
+function dissectionPoint(left, right, j) {
+    return Math.trunc(((dissectionArity - j) * left + j * right + 2 * j - dissectionArity) / dissectionArity);
+}
 
 const disagreeStep = 11;
 
 	let left = 0;
-	let right = MAX_CYCLE;
+	let right = DISSECTION_RIGHT;
 	let lastAgree = 0;
 	let lastDisagree = MAX_CYCLE;
 
-	let prover_bisection_cycle = Array(BISECTION_STEPS).fill(0);
+	let prover_bisection_cycle = [];
         let verifier_bisections = Array(BISECTION_STEPS).fill(0);
         
 
-    prover_bisection_RAM = Array(BISECTION_STEPS).fill([]);
-     let bisect_step = 0;
+    prover_bisection_RAM = [];
      
      for (let i = 0; i < BISECTION_STEPS; i++) {
-		let mid = Math.floor((left + right) / 2);
-//                console.log("Bisect step " + i + " mid " + mid);
-
-		prover_bisection_cycle[i] = mid;
-		if (mid >= stepsOut.length) {
-//		   console.log("Got out of range step " + mid + " >= " + stepsOut.length + ", repeating last step, assuming halted state");
-		   prover_bisection_RAM[i] = stepsOut[stepsOut.length - 1].ram_after;
-		} else {
-//		   console.log("setting ram for " + (bisect_step) + " for " + mid);
-                   prover_bisection_RAM[i] = stepsOut[mid].ram;
-                }
-		if (mid < disagreeStep) {
-			lastAgree = mid;
-			left = mid + 1;
-			verifier_bisections[i] = 1;
-		} else {
-			lastDisagree = mid;
-			right = mid - 1;
-			verifier_bisections[i] = 0;
+		const points = [];
+		let agreed = 0;
+		for (let j = 1; j <= DISSECTION_POINTS; j++) {
+			const point = dissectionPoint(left, right, j);
+			points.push(point);
+			prover_bisection_cycle.push(point);
+			if (point >= stepsOut.length) {
+//			   console.log("Got out of range step " + point + " >= " + stepsOut.length + ", repeating last step, assuming halted state");
+			   prover_bisection_RAM.push(stepsOut[stepsOut.length - 1].ram_after);
+			} else {
+			   prover_bisection_RAM.push(stepsOut[point].ram);
+			}
+			if (point < disagreeStep && agreed == j - 1) {
+				agreed = j;
+			}
+		}
+		verifier_bisections[i] = agreed;
+		if (agreed > 0) {
+			lastAgree = points[agreed - 1];
+			left = lastAgree + 1;
+		}
+		if (agreed < DISSECTION_POINTS) {
+			lastDisagree = points[agreed];
+			right = lastDisagree - 1;
 		}
-		bisect_step++;
 	}  
 	let agree_ram = 0, disagree_ram = 0;
-	for (let i = 0; i < BISECTION_STEPS; i++) {
+	for (let i = 0; i < prover_bisection_cycle.length; i++) {
 		if (prover_bisection_cycle[i] == lastAgree) {
 			agree_ram = i;
 		}
 	}
-	for (let i = 0; i < BISECTION_STEPS; i++) {
+	for (let i = 0; i < prover_bisection_cycle.length; i++) {
 		if (prover_bisection_cycle[i] == lastDisagree) {
         		disagree_ram = i;
 		}
@@ -162,39 +256,230 @@ for (let i = 0; i < 1024; i++) {
 /* console.log(JSON.stringify(prover_bisection_RAM));
 */
 
-if (prover_agree_RAM.length != 1024 || prover_disagree_RAM.length != 1024) {
+if (prover_agree_RAM.length != RAM_WORDS || prover_disagree_RAM.length != RAM_WORDS) {
    console.log("ram mismatch");
    process.exit(1);
 }
 
-if (prover_bisection_RAM.length != 30) {
+if (prover_bisection_RAM.length != BISECTION_STEPS * DISSECTION_POINTS) {
    console.log("bisection RAM mismatch");
    process.exit(1);
 }
-if (verifier_bisections.length != 30) {
+// has to match AGREE_SNAPSHOT/DISAGREE_SNAPSHOT in rv64i.c
+if (publicSchedule) {
+   prover_bisection_RAM = [prover_bisection_RAM[agree_ram], prover_bisection_RAM[disagree_ram]];
+}
+if (wrongSnapshot) {
+   // a word the step does not touch, so only the snapshot compare can catch it
+   const agreeIndex = publicSchedule ? 0 : agree_ram;
+   const snapshot = prover_bisection_RAM[agreeIndex].slice();
+   snapshot[RAM_WORDS - 1] = "0x" + (BigInt(snapshot[RAM_WORDS - 1]) ^ 1n).toString(16);
+   prover_bisection_RAM = prover_bisection_RAM.slice();
+   prover_bisection_RAM[agreeIndex] = snapshot;
+}
+if (verifier_bisections.length != BISECTION_STEPS) {
    console.log("bisections mismatch");
    process.exit(1);
 }
 
-console.log('input := { ram: ' + JSON.stringify(stepsOut[lastAgree].ram).replaceAll('"', '') + '; ram_disagree: ' + JSON.stringify(stepsOut[lastAgree+1].ram).replaceAll('"', '') + '; ' + 
-    'prover_bisection_RAM: ' + JSON.stringify(prover_bisection_RAM).replaceAll('"', '') + '; ' +
+// pick the step circuit from the instruction word: access 2 reads the pc, access 3 the word holding the instruction
+let stepClass = INSN_CLASSES[0];
+if (perClass) {
+    const pc = BigInt(stepsOut[lastAgree].access_val[2]);
+    const insn = Number((BigInt(stepsOut[lastAgree].access_val[3]) >> ((pc & 7n) * 8n)) & 0xffffffffn);
+    stepClass = INSN_CLASSES[insnClass(insn)];
+    console.error("insn 0x" + insn.toString(16) + " class " + stepClass.name + " (INSN_CLASS_" + stepClass.name.toUpperCase() + ")");
+}
+const logSize = stepClass.logSize;
+for (const field of ["access_paddr", "access_val", "access_readWriteEnd"]) {
+    stepsOut[lastAgree][field] = stepsOut[lastAgree][field].slice(0, logSize);
+}
+
+// has to match packSlot in rv64i.c: word index of the StandardRAM in the low bits, tag in bits 14-15
+function packSlot(paddr, tag) {
+    if (!ramContains(paddr)) {
+        throw "cannot pack address 0x" + paddr.toString(16);
+    }
+    return ramWord(paddr) | (tag << 14);
+}
+
+// Keccak256 (0x01 padding) for the Merkle roots, has to match Keccak() in keccak256-c.c
+const KECCAK_RC = [0x1n, 0x8082n, 0x800000000000808an, 0x8000000080008000n, 0x808bn, 0x80000001n, 0x8000000080008081n, 0x8000000000008009n,
+    0x8an, 0x88n, 0x80008009n, 0x8000000an, 0x8000808bn, 0x800000000000008bn, 0x8000000000008089n, 0x8000000000008003n,
+    0x8000000000008002n, 0x8000000000000080n, 0x800an, 0x800000008000000an, 0x8000000080008081n, 0x8000000000008080n, 0x80000001n, 0x8000000080008008n];
+const KECCAK_ROT = [0, 1, 62, 28, 27, 36, 44, 6, 55, 20, 3, 10, 43, 25, 39, 41, 45, 15, 21, 8, 18, 2, 61, 56, 14];
+const LANE_MASK = (1n << 64n) - 1n;
+
+function rol64(v, r) {
+    return r == 0 ? v : ((v << BigInt(r)) | (v >> BigInt(64 - r))) & LANE_MASK;
+}
+
+function keccakF1600(s) {
+    for (let round = 0; round < 24; round++) {
+        const C = [0, 1, 2, 3, 4].map(x => s[x] ^ s[x + 5] ^ s[x + 10] ^ s[x + 15] ^ s[x + 20]);
+        for (let x = 0; x < 5; x++) {
+            const D = C[(x + 4) % 5] ^ rol64(C[(x + 1) % 5], 1);
+            for (let y = 0; y < 25; y += 5) {
+                s[x + y] ^= D;
+            }
+        }
+        const B = Array(25);
+        for (let x = 0; x < 5; x++) {
+            for (let y = 0; y < 5; y++) {
+                B[y + 5 * ((2 * x + 3 * y) % 5)] = rol64(s[x + 5 * y], KECCAK_ROT[x + 5 * y]);
+            }
+        }
+        for (let y = 0; y < 25; y += 5) {
+            for (let x = 0; x < 5; x++) {
+                s[x + y] = B[x + y] ^ (~B[(x + 1) % 5 + y] & LANE_MASK & B[(x + 2) % 5 + y]);
+            }
+        }
+        s[0] ^= KECCAK_RC[round];
+    }
+}
+
+// single block only, enough for the 8 and 64 byte Merkle inputs
+function keccak256(bytes) {
+    const s = Array(25).fill(0n);
+    const block = Buffer.alloc(136);
+    bytes.copy(block);
+    block[bytes.length] ^= 0x01;
+    block[135] ^= 0x80;
+    for (let i = 0; i < 17; i++) {
+        s[i] ^= block.readBigUInt64LE(i * 8);
+    }
+    keccakF1600(s);
+    const out = Buffer.alloc(32);
+    for (let i = 0; i < 4; i++) {
+        out.writeBigUInt64LE(s[i], i * 8);
+    }
+    return out;
+}
+
+// has to match merkleLeaf/merklePathRoot in rv64i.c
+const MERKLE_DEPTH = ramWordBits;
+const merkleCache = new Map();
+
+function merkleHash(bytes) {
+    const key = bytes.toString("hex");
+    if (!merkleCache.has(key)) {
+        merkleCache.set(key, keccak256(bytes));
+    }
+    return merkleCache.get(key);
+}
+
+function merkleLeaf(val) {
+    const word = Buffer.alloc(8);
+    word.writeBigUInt64LE(BigInt(val));
+    return merkleHash(word);
+}
+
+// levels[0] are the leaves, levels[MERKLE_DEPTH][0] is the root
+function merkleTree(ram) {
+    const levels = [ram.map(merkleLeaf)];
+    for (let level = 0; level < MERKLE_DEPTH; level++) {
+        const below = levels[level];
+        levels.push(Array.from({ length: below.length / 2 }, (_, i) => merkleHash(Buffer.concat([below[2 * i], below[2 * i + 1]]))));
+    }
+    return levels;
+}
+
+function merkleSiblings(levels, word) {
+    return Array.from({ length: MERKLE_DEPTH }, (_, level) => levels[level][(word >> level) ^ 1]);
+}
+
+function merkleSet(levels, word, val) {
+    levels[0][word] = merkleLeaf(val);
+    for (let level = 0; level < MERKLE_DEPTH; level++) {
+        const i = word >> (level + 1);
+        levels[level + 1][i] = merkleHash(Buffer.concat([levels[level][2 * i], levels[level][2 * i + 1]]));
+    }
+}
+
+function merkleRoot(ram) {
+    return merkleTree(ram)[MERKLE_DEPTH][0];
+}
+
+const hashJSON = (h) => JSON.stringify([...h]);
+
+const bisectionsFieldSpec = publicSchedule ? '' : 'verifier_bisections: ' + JSON.stringify(verifier_bisections) + '; ';
+const bisectionsFieldTester = '     ' + (publicSchedule ? '' : '.verifier_bisections = ' + JSON.stringify(verifier_bisections).replaceAll("[", "{").replaceAll("]", "}") + ', ');
+
+let accessSpec, accessTester;
+let bisectionsSpec, bisectionsTester;
+if (merkleInput) {
+    const step = stepsOut[lastAgree];
+    const levels = merkleTree(step.ram);
+    const ram = step.ram.slice();
+    const prevVals = Array(logSize).fill(0);
+    const siblings = Array(logSize).fill(Array(MERKLE_DEPTH).fill(Buffer.alloc(32)));
+    const end = step.access_readWriteEnd.indexOf(2);
+    for (let i = 0; i < end; i++) {
+        const word = ramWord(step.access_paddr[i]);
+        siblings[i] = merkleSiblings(levels, word);
+        if (step.access_readWriteEnd[i] == 1) {
+            prevVals[i] = ram[word];
+            ram[word] = step.access_val[i];
+            merkleSet(levels, word, step.access_val[i]);
+        }
+    }
+    const siblingsJSON = '[' + siblings.map(path => '[' + path.map(hashJSON).join(',') + ']').join(',') + ']';
+    accessSpec = 'access_paddr: ' + JSON.stringify(step.access_paddr) + '; access_val: ' + JSON.stringify(step.access_val).replaceAll('"', '') + '; access_readWriteEnd: ' + JSON.stringify(step.access_readWriteEnd) + '; ' +
+        'access_prev_val: ' + JSON.stringify(prevVals).replaceAll('"', '') + '; access_siblings: ' + siblingsJSON + '; ';
+    accessTester = '     .access_paddr = ' + JSON.stringify(step.access_paddr).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_val = ' + JSON.stringify(step.access_val).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_readWriteEnd = ' + JSON.stringify(step.access_readWriteEnd).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_prev_val = ' + JSON.stringify(prevVals).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_siblings = ' + siblingsJSON.replaceAll("[", "{").replaceAll("]", "}") + ',\n';
+    bisectionsSpec = bisectionsFieldSpec + 'pad: 0; };';
+    bisectionsTester = bisectionsFieldTester + '.pad = 0 };\n';
+} else if (packedInput) {
+    const slots = stepsOut[lastAgree].access_paddr.map((paddr, i) => packSlot(paddr, stepsOut[lastAgree].access_readWriteEnd[i]));
+    const bisections = verifier_bisections.reduce((bits, b, i) => bits + b * 2 ** (i * Math.log2(dissectionArity)), 0);
+    accessSpec = 'access_slot: ' + JSON.stringify(slots) + '; access_val: ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '') + '; ';
+    accessTester = '     .access_slot = ' + JSON.stringify(slots).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_val = ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
+    bisectionsSpec = (publicSchedule ? '' : 'verifier_bisections: ' + bisections + '; ') + '};';
+    bisectionsTester = '     ' + (publicSchedule ? '' : '.verifier_bisections = ' + bisections + ', ') + '};\n';
+} else {
     /* lastAgree isn't perfect here for > steps.length */
-    'access_paddr: ' + JSON.stringify(stepsOut[lastAgree].access_paddr) + '; access_val: ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '') +'; access_readWriteEnd: ' + JSON.stringify(stepsOut[lastAgree].access_readWriteEnd) + '; ' + 
-    'verifier_bisections: ' + JSON.stringify(verifier_bisections) + '; pad: 0; };');
-console.log('return_value == 0;');
+    accessSpec = 'access_paddr: ' + JSON.stringify(stepsOut[lastAgree].access_paddr) + '; access_val: ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '') +'; access_readWriteEnd: ' + JSON.stringify(stepsOut[lastAgree].access_readWriteEnd) + '; ';
+    accessTester = '     .access_paddr = ' + JSON.stringify(stepsOut[lastAgree].access_paddr).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_val = ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .access_readWriteEnd = ' + JSON.stringify(stepsOut[lastAgree].access_readWriteEnd).replaceAll("[", "{").replaceAll("]", "}") + ',\n';
+    bisectionsSpec = bisectionsFieldSpec + 'pad: 0; };';
+    bisectionsTester = bisectionsFieldTester + '.pad = 0 };\n';
+}
+
+let snapshotSpec, snapshotTester;
+if (merkleInput) {
+    const roots = prover_bisection_RAM.map(merkleRoot);
+    const rootsJSON = '[' + roots.map(hashJSON).join(',') + ']';
+    snapshotSpec = 'root: ' + hashJSON(merkleRoot(stepsOut[lastAgree].ram)) + '; root_disagree: ' + hashJSON(merkleRoot(stepsOut[lastAgree+1].ram)) + '; ' +
+        'prover_bisection_root: ' + rootsJSON + '; ';
+    snapshotTester = '     .root = ' + hashJSON(merkleRoot(stepsOut[lastAgree].ram)).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .root_disagree = ' + hashJSON(merkleRoot(stepsOut[lastAgree+1].ram)).replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .prover_bisection_root = ' + rootsJSON.replaceAll("[", "{").replaceAll("]", "}") + ',\n';
+} else {
+    snapshotSpec = 'ram: ' + JSON.stringify(stepsOut[lastAgree].ram).replaceAll('"', '') + '; ram_disagree: ' + JSON.stringify(stepsOut[lastAgree+1].ram).replaceAll('"', '') + '; ' +
+        'prover_bisection_RAM: ' + JSON.stringify(prover_bisection_RAM).replaceAll('"', '') + '; ';
+    snapshotTester = '     .ram = ' + JSON.stringify(stepsOut[lastAgree].ram).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .ram_disagree = ' + JSON.stringify(stepsOut[lastAgree+1].ram).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n' +
+        '     .prover_bisection_RAM = ' + JSON.stringify(prover_bisection_RAM).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
+}
+
+console.log('input := { ' + snapshotSpec + accessSpec + bisectionsSpec);
+console.log('return_value == ' + (wrongSnapshot ? 1 : 0) + ';');
 console.log('---');
 
-let tester = '#define RV64I_VERBOSE\n#define __CPROVER_assume(x) do { } while (0)\n#include <stdio.h>\n#include "rv64i.c"\n'
+let tester = (perClass ? '#define INSN_CLASS INSN_CLASS_' + stepClass.name.toUpperCase() + '\n' : '') + (packedInput ? '#define RV64I_PACKED_INPUT\n' : '') + (merkleInput ? '#define RV64I_MERKLE\n' : '') + (publicSchedule ? '#define BISECTION_SCHEDULE_PUBLIC\n' : '') + (option("--arity") !== undefined ? '#define DISSECTION_ARITY ' + dissectionArity + '\n' : '') +
+    (defaultGeometry ? '' : '#define RAM_WORD_BITS ' + ramWordBits + '\n#define RAM_WINDOWS {' + ramWindows.map(w => '{' + w.start + ', ' + w.size + '}').join(', ') + '}\n') + '#define RV64I_VERBOSE\n#define __CPROVER_assume(x) do { } while (0)\n#include <stdio.h>\n#include "rv64i.c"\n'
 tester += 'int main() {\n';
 tester += '  // ' + lastAgree + ' and ' + lastDisagree + '\n';
-tester += '  struct BisectInput input = {\n';
-tester += '     .ram = ' + JSON.stringify(stepsOut[lastAgree].ram).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .ram_disagree = ' + JSON.stringify(stepsOut[lastAgree+1].ram).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .prover_bisection_RAM = ' + JSON.stringify(prover_bisection_RAM).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .access_paddr = ' + JSON.stringify(stepsOut[lastAgree].access_paddr).replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .access_val = ' + JSON.stringify(stepsOut[lastAgree].access_val).replaceAll('"', '').replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .access_readWriteEnd = ' + JSON.stringify(stepsOut[lastAgree].access_readWriteEnd).replaceAll("[", "{").replaceAll("]", "}") + ',\n';
-tester += '     .verifier_bisections = ' + JSON.stringify(verifier_bisections).replaceAll("[", "{").replaceAll("]", "}") + ', .pad = 0 };\n';
+tester += '  struct ' + (packedInput ? 'PackedBisectInput' : merkleInput ? 'MerkleBisectInput' : 'BisectInput') + ' input = {\n';
+tester += snapshotTester;
+tester += accessTester;
+tester += bisectionsTester;
 tester += '   return mpc_main(input); }\n';
 
 fs.writeFileSync("tester.c", tester);
@@ -0,0 +1,358 @@
+// Generates Keccak circuits in Bristol format directly, without cbmc-gc.
+//
+// The Keccak-f[1600] permutation is written out bit by bit: θ, ρ, π and ι are
+// XORs, wirings and INVs (free in garbled circuits), χ is computed as
+// a ^ c ^ (b & c), one AND per state bit, so every round has exactly 1600 ANDs
+// and the permutation 38400. Constants (round constants, the zero capacity,
+// the padding) are folded while building, so a sponge only keeps the gates
+// that depend on its input.
+//
+// node keccak-bristol.js > keccak-f1600.txt                      the permutation, 1600 -> 1600 bits
+// node keccak-bristol.js --bytes 64 > keccak256-64.txt           Keccak256 (Keccak_SHA256) of 64 bytes
+// node keccak-bristol.js --bytes 64 --suffix 0x06 > sha3-64.txt  FIPS202_SHA3_256 of 64 bytes
+// node keccak-bristol.js --block > keccak-block.txt              one sponge block, for circuit-seq
+// node keccak-bristol.js --bytes 8192 --verify > mpc_main.txt     mpc_main of keccak256.c (memory, digest -> int)
+// node keccak-bristol.js --table 8,64,4096 [--dir d] [--suffix s] verification circuits of several lengths,
+//                                                                 with a table of their sizes on stdout
+//
+// Bits are numbered as in the byte arrays of keccak256-c.c: wire 8 * k + b is
+// bit b (LSB first) of byte k, so the state wire 64 * (x + 5 * y) + z is bit z
+// of lane (x, y). The outputs are the last wires, as in the circuits
+// circuit-utils --as-bristol writes. Gate counts go to stderr.
+//
+// The block circuit takes the 1600 state bits and then the 1088 bits of a
+// padded message block, and outputs the state after absorbing the block. Its
+// state wires are the first inputs and the outputs, so circuit-seq can run it
+// once per block.
+//
+// The builder is also a module, for circuits that use the permutation:
+// const { Circuit, keccakF, sponge } = require("./keccak-bristol.js");
+// It does not splice into cbmc-gc output: an mpc_main built by cbmc-gc, such
+// as rv64i.c with RV64I_MERKLE, keeps the Keccak its C code compiles to.
+
+const fs = require("fs");
+
+const ZERO = -1;
+const ONE = -2;
+const OPS = ["AND", "XOR", "INV"];
+const AND = 0, XOR = 1, INV = 2;
+
+// Gates are kept in typed arrays, a multi-block sponge has millions of them
+class Circuit {
+    constructor(inputs) {
+        this.inputs = inputs;
+        this.wires = inputs;
+        this.gates = 0;
+        this.op = new Uint8Array(1 << 16);
+        this.in0 = new Int32Array(1 << 16);
+        this.in1 = new Int32Array(1 << 16);
+        this.used = new Uint8Array(Math.max(inputs, 1) + (1 << 16));
+        this.counts = { AND: 0, XOR: 0, INV: 0 };
+    }
+
+    gate(op, a, b = -1) {
+        if (this.gates == this.op.length) {
+            const grow = (array, size) => { const bigger = new array.constructor(size); bigger.set(array); return bigger; };
+            this.op = grow(this.op, 2 * this.gates);
+            this.in0 = grow(this.in0, 2 * this.gates);
+            this.in1 = grow(this.in1, 2 * this.gates);
+        }
+        if (this.wires >= this.used.length) {
+            const used = new Uint8Array(2 * this.used.length);
+            used.set(this.used);
+            this.used = used;
+        }
+        this.used[a] = 1;
+        if (b >= 0) {
+            this.used[b] = 1;
+        }
+        this.op[this.gates] = op;
+        this.in0[this.gates] = a;
+        this.in1[this.gates] = b;
+        this.gates++;
+        this.counts[OPS[op]]++;
+        return this.wires++;
+    }
+
+    xor(a, b) {
+        if (a == ZERO) return b;
+        if (b == ZERO) return a;
+        if (a == ONE) return this.inv(b);
+        if (b == ONE) return this.inv(a);
+        if (a == b) return ZERO;
+        return this.gate(XOR, a, b);
+    }
+
+    and(a, b) {
+        if (a == ZERO || b == ZERO) return ZERO;
+        if (a == ONE) return b;
+        if (b == ONE || a == b) return a;
+        return this.gate(AND, a, b);
+    }
+
+    or(a, b) {
+        if (a == ZERO) return b;
+        if (b == ZERO) return a;
+        if (a == ONE || b == ONE) return ONE;
+        if (a == b) return a;
+        return this.inv(this.and(this.inv(a), this.inv(b)));
+    }
+
+    inv(a) {
+        if (a == ZERO) return ONE;
+        if (a == ONE) return ZERO;
+        return this.gate(INV, a);
+    }
+
+    // a wire that only feeds one output: outputs that are inputs, constants, repeated
+    // or also used by other gates get a copy (two INVs, still free)
+    outputWire(w, repeated) {
+        if (w >= this.inputs && !repeated && !this.used[w]) {
+            return w;
+        }
+        if (w == ZERO || w == ONE) {
+            if (this.inputs == 0) {
+                throw "constant output in a circuit without inputs";
+            }
+            const zero = this.gate(XOR, 0, 0);
+            return w == ZERO ? this.gate(INV, this.gate(INV, zero)) : this.gate(INV, zero);
+        }
+        return this.gate(INV, this.gate(INV, w));
+    }
+
+    // writes the Bristol text to fd, with the outputs renumbered to the last wires
+    write(fd, outputs) {
+        const seen = new Map();
+        for (const w of outputs) {
+            seen.set(w, (seen.get(w) || 0) + 1);
+        }
+        const outs = outputs.map(w => this.outputWire(w, seen.get(w) > 1));
+        // wire w is the output of gate w - inputs
+        const number = new Int32Array(this.wires);
+        const first = this.wires - outs.length;
+        const last = new Int32Array(outs.length);
+        number.fill(-1, this.inputs);
+        outs.forEach((w, i) => {
+            number[w] = first + i;
+            last[i] = w - this.inputs;
+        });
+        for (let i = 0; i < this.inputs; i++) {
+            number[i] = i;
+        }
+        let text = this.gates + " " + this.wires + "\n" + this.inputs + " 0 " + outs.length + "\n\n";
+        const line = g => {
+            const out = number[this.inputs + g];
+            text += this.op[g] == INV ?
+                "1 1 " + number[this.in0[g]] + " " + out + " INV\n" :
+                "2 1 " + number[this.in0[g]] + " " + number[this.in1[g]] + " " + out + " " + OPS[this.op[g]] + "\n";
+            if (text.length > (1 << 20)) {
+                fs.writeSync(fd, text);
+                text = "";
+            }
+        };
+        let next = this.inputs;
+        for (let g = 0; g < this.gates; g++) {
+            if (number[this.inputs + g] < 0) {
+                number[this.inputs + g] = next++;
+                line(g);
+            }
+        }
+        last.forEach(line);
+        fs.writeSync(fd, text);
+    }
+}
+
+const lane = (x, y) => 64 * (x + 5 * y);
+
+// ρ offsets and ι constants as keccak256-c.c derives them (ρ/π walk and LFSR86540)
+const RHO = new Array(25).fill(0);
+{
+    let x = 1, y = 0;
+    for (let t = 0; t < 24; t++) {
+        RHO[x + 5 * y] = ((t + 1) * (t + 2) / 2) % 64;
+        [x, y] = [y, (2 * x + 3 * y) % 5];
+    }
+}
+const ROUND_CONSTANT_BITS = [];
+{
+    let lfsr = 0x01;
+    for (let round = 0; round < 24; round++) {
+        const bits = [];
+        for (let j = 0; j < 7; j++) {
+            if (lfsr & 0x01) {
+                bits.push((1 << j) - 1);
+            }
+            lfsr = lfsr & 0x80 ? ((lfsr << 1) ^ 0x71) & 0xff : lfsr << 1;
+        }
+        ROUND_CONSTANT_BITS.push(bits);
+    }
+}
+
+// Keccak-f[1600] on an array of 1600 wires, returns the permuted wires
+function keccakF(c, a, rounds = 24) {
+    for (let round = 0; round < rounds; round++) {
+        // θ
+        const parity = [];
+        for (let x = 0; x < 5; x++) {
+            for (let z = 0; z < 64; z++) {
+                let p = a[lane(x, 0) + z];
+                for (let y = 1; y < 5; y++) {
+                    p = c.xor(p, a[lane(x, y) + z]);
+                }
+                parity[64 * x + z] = p;
+            }
+        }
+        const theta = [];
+        for (let x = 0; x < 5; x++) {
+            for (let z = 0; z < 64; z++) {
+                const d = c.xor(parity[64 * ((x + 4) % 5) + z], parity[64 * ((x + 1) % 5) + (z + 63) % 64]);
+                for (let y = 0; y < 5; y++) {
+                    theta[lane(x, y) + z] = c.xor(a[lane(x, y) + z], d);
+                }
+            }
+        }
+        // ρ and π: lane (x, y) rotated by RHO moves to (y, 2x + 3y)
+        const b = [];
+        for (let x = 0; x < 5; x++) {
+            for (let y = 0; y < 5; y++) {
+                const to = lane(y, (2 * x + 3 * y) % 5);
+                for (let z = 0; z < 64; z++) {
+                    b[to + (z + RHO[x + 5 * y]) % 64] = theta[lane(x, y) + z];
+                }
+            }
+        }
+        // χ: b0 ^ (~b1 & b2) = b0 ^ b2 ^ (b1 & b2)
+        for (let y = 0; y < 5; y++) {
+            for (let x = 0; x < 5; x++) {
+                for (let z = 0; z < 64; z++) {
+                    const b1 = b[lane((x + 1) % 5, y) + z];
+                    const b2 = b[lane((x + 2) % 5, y) + z];
+                    a[lane(x, y) + z] = c.xor(c.xor(b[lane(x, y) + z], b2), c.and(b1, b2));
+                }
+            }
+        }
+        // ι
+        for (const z of ROUND_CONSTANT_BITS[round]) {
+            a[z] = c.inv(a[z]);
+        }
+    }
+    return a;
+}
+
+// The permutation is built once and then replayed gate by gate for every
+// block and every variant; the replay still folds constants, e.g. the zero
+// capacity of the first block
+let permutationTemplate = null;
+
+function permute(c, state) {
+    if (permutationTemplate === null) {
+        const t = new Circuit(1600);
+        permutationTemplate = { circuit: t, outputs: keccakF(t, [...Array(1600).keys()]) };
+    }
+    const t = permutationTemplate.circuit;
+    const wire = new Int32Array(t.wires);
+    wire.set(state);
+    for (let g = 0; g < t.gates; g++) {
+        const a = wire[t.in0[g]];
+        wire[t.inputs + g] = t.op[g] == AND ? c.and(a, wire[t.in1[g]]) : t.op[g] == XOR ? c.xor(a, wire[t.in1[g]]) : c.inv(a);
+    }
+    return permutationTemplate.outputs.map(w => wire[w]);
+}
+
+const RATE = 1088;
+
+// The padded message as blocks of RATE wires: the message bits, then the
+// suffix and the final 1 bit as constants, with an extra block when a suffix
+// with its top bit set ends in the last byte of a block (as Keccak() in
+// keccak256-c.c). Shared by every length; circuit-seq -p pads the same way.
+function padBlocks(message, suffix) {
+    const bits = message.length;
+    let padded = (Math.floor(bits / RATE) + 1) * RATE;
+    if ((suffix & 0x80) && bits % RATE == RATE - 8) {
+        padded += RATE;
+    }
+    const m = [...message, ...new Array(padded - bits).fill(ZERO)];
+    for (let b = 0; b < 8; b++) {
+        if ((suffix >> b) & 1) {
+            m[bits + b] = ONE;
+        }
+    }
+    m[padded - 1] = m[padded - 1] == ONE ? ZERO : ONE;
+    const blocks = [];
+    for (let offset = 0; offset < padded; offset += RATE) {
+        blocks.push(m.slice(offset, offset + RATE));
+    }
+    return blocks;
+}
+
+// Keccak sponge with capacity 512 (Keccak256/SHA3-256) over the wires of a byte
+// message, returns the 256 digest wires
+function sponge(c, message, suffix) {
+    let state = new Array(1600).fill(ZERO);
+    for (const block of padBlocks(message, suffix)) {
+        for (let i = 0; i < RATE; i++) {
+            state[i] = c.xor(state[i], block[i]);
+        }
+        state = permute(c, state);
+    }
+    return state.slice(0, 256);
+}
+
+// mpc_main of keccak256.c and sha3-256.c for a bytes-long memory: inputs the
+// memory and the expected digest, outputs the 32 bits of the int it returns,
+// 0 when the digest matches and 1 otherwise
+function verifyCircuit(bytes, suffix) {
+    const c = new Circuit(8 * bytes + 256);
+    const hash = sponge(c, [...Array(8 * bytes).keys()], suffix);
+    let differ = ZERO;
+    for (let i = 0; i < 256; i++) {
+        differ = c.or(differ, c.xor(hash[i], 8 * bytes + i));
+    }
+    return { c, outputs: [differ, ...new Array(31).fill(ZERO)] };
+}
+
+module.exports = { Circuit, keccakF, permute, padBlocks, sponge, verifyCircuit, ZERO, ONE };
+
+if (require.main === module) {
+    const argv = process.argv;
+    const option = name => argv.indexOf(name) < 0 ? undefined : argv[argv.indexOf(name) + 1];
+    const suffix = option("--suffix") !== undefined ? Number(option("--suffix")) : 0x01;
+    if (option("--table") !== undefined) {
+        // one verification circuit per length, written to --dir, and their sizes as a table
+        const dir = option("--dir") !== undefined ? option("--dir") : ".";
+        const name = suffix == 0x06 ? "sha3-256" : "keccak256";
+        console.log("| bytes | blocks | AND | XOR | INV | gates | ms |");
+        console.log("|---|---|---|---|---|---|---|");
+        for (const bytes of option("--table").split(",").map(Number)) {
+            const t0 = process.hrtime.bigint();
+            const { c, outputs } = verifyCircuit(bytes, suffix);
+            const fd = fs.openSync(dir + "/" + name + "-" + bytes + ".txt", "w");
+            c.write(fd, outputs);
+            fs.closeSync(fd);
+            const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+            console.log("| " + [bytes, padBlocks(new Array(8 * bytes), suffix).length, c.counts.AND, c.counts.XOR,
+                c.counts.INV, c.gates, ms.toFixed(0)].join(" | ") + " |");
+        }
+        return;
+    }
+    let c, outputs;
+    if (argv.includes("--block")) {
+        c = new Circuit(1600 + RATE);
+        const state = [...Array(1600).keys()];
+        for (let i = 0; i < RATE; i++) {
+            state[i] = c.xor(state[i], 1600 + i);
+        }
+        outputs = permute(c, state);
+    } else if (option("--bytes") !== undefined && argv.includes("--verify")) {
+        ({ c, outputs } = verifyCircuit(Number(option("--bytes")), suffix));
+    } else if (option("--bytes") !== undefined) {
+        const bytes = Number(option("--bytes"));
+        c = new Circuit(8 * bytes);
+        outputs = sponge(c, [...Array(8 * bytes).keys()], suffix);
+    } else {
+        c = new Circuit(1600);
+        outputs = keccakF(c, [...Array(1600).keys()]);
+    }
+    c.write(1, outputs);
+    console.error("gates " + c.gates + ": AND " + c.counts.AND + ", XOR " + c.counts.XOR + ", INV " + c.counts.INV);
+}
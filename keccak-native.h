@@ -0,0 +1,321 @@
+// Native Keccak-256 for the host-side tools (merkle.h and the drivers built on it).
+//
+// keccak256-c.c is the reference the circuits are compiled from and stays
+// readable rather than fast; this is the same permutation with the 25 lanes
+// kept in locals and the rounds unrolled, about 8x faster natively. The
+// hashes are Keccak-256 (suffix 0x01), i.e. Keccak_SHA256 of keccak256-c.c.
+// Assumes a little-endian host.
+
+#ifndef KECCAK_NATIVE_H
+#define KECCAK_NATIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define KECCAK256_RATE 136
+
+static const uint64_t keccak_round_constants[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+
+#define KECCAK_ROL(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+// one round on the lanes axy (x + 5 y), through bxy
+#define KECCAK_ROUND(rc) do { \
+        c0 = a00 ^ a01 ^ a02 ^ a03 ^ a04; \
+        c1 = a10 ^ a11 ^ a12 ^ a13 ^ a14; \
+        c2 = a20 ^ a21 ^ a22 ^ a23 ^ a24; \
+        c3 = a30 ^ a31 ^ a32 ^ a33 ^ a34; \
+        c4 = a40 ^ a41 ^ a42 ^ a43 ^ a44; \
+        d0 = c4 ^ KECCAK_ROL(c1, 1); \
+        d1 = c0 ^ KECCAK_ROL(c2, 1); \
+        d2 = c1 ^ KECCAK_ROL(c3, 1); \
+        d3 = c2 ^ KECCAK_ROL(c4, 1); \
+        d4 = c3 ^ KECCAK_ROL(c0, 1); \
+        b00 = a00 ^ d0; \
+        b13 = KECCAK_ROL(a01 ^ d0, 36); \
+        b21 = KECCAK_ROL(a02 ^ d0, 3); \
+        b34 = KECCAK_ROL(a03 ^ d0, 41); \
+        b42 = KECCAK_ROL(a04 ^ d0, 18); \
+        b02 = KECCAK_ROL(a10 ^ d1, 1); \
+        b10 = KECCAK_ROL(a11 ^ d1, 44); \
+        b23 = KECCAK_ROL(a12 ^ d1, 10); \
+        b31 = KECCAK_ROL(a13 ^ d1, 45); \
+        b44 = KECCAK_ROL(a14 ^ d1, 2); \
+        b04 = KECCAK_ROL(a20 ^ d2, 62); \
+        b12 = KECCAK_ROL(a21 ^ d2, 6); \
+        b20 = KECCAK_ROL(a22 ^ d2, 43); \
+        b33 = KECCAK_ROL(a23 ^ d2, 15); \
+        b41 = KECCAK_ROL(a24 ^ d2, 61); \
+        b01 = KECCAK_ROL(a30 ^ d3, 28); \
+        b14 = KECCAK_ROL(a31 ^ d3, 55); \
+        b22 = KECCAK_ROL(a32 ^ d3, 25); \
+        b30 = KECCAK_ROL(a33 ^ d3, 21); \
+        b43 = KECCAK_ROL(a34 ^ d3, 56); \
+        b03 = KECCAK_ROL(a40 ^ d4, 27); \
+        b11 = KECCAK_ROL(a41 ^ d4, 20); \
+        b24 = KECCAK_ROL(a42 ^ d4, 39); \
+        b32 = KECCAK_ROL(a43 ^ d4, 8); \
+        b40 = KECCAK_ROL(a44 ^ d4, 14); \
+        a00 = b00 ^ (~b10 & b20); \
+        a10 = b10 ^ (~b20 & b30); \
+        a20 = b20 ^ (~b30 & b40); \
+        a30 = b30 ^ (~b40 & b00); \
+        a40 = b40 ^ (~b00 & b10); \
+        a01 = b01 ^ (~b11 & b21); \
+        a11 = b11 ^ (~b21 & b31); \
+        a21 = b21 ^ (~b31 & b41); \
+        a31 = b31 ^ (~b41 & b01); \
+        a41 = b41 ^ (~b01 & b11); \
+        a02 = b02 ^ (~b12 & b22); \
+        a12 = b12 ^ (~b22 & b32); \
+        a22 = b22 ^ (~b32 & b42); \
+        a32 = b32 ^ (~b42 & b02); \
+        a42 = b42 ^ (~b02 & b12); \
+        a03 = b03 ^ (~b13 & b23); \
+        a13 = b13 ^ (~b23 & b33); \
+        a23 = b23 ^ (~b33 & b43); \
+        a33 = b33 ^ (~b43 & b03); \
+        a43 = b43 ^ (~b03 & b13); \
+        a04 = b04 ^ (~b14 & b24); \
+        a14 = b14 ^ (~b24 & b34); \
+        a24 = b24 ^ (~b34 & b44); \
+        a34 = b34 ^ (~b44 & b04); \
+        a44 = b44 ^ (~b04 & b14); \
+        a00 ^= (rc); \
+    } while (0)
+
+// Keccak-f[1600] on 25 lanes of type T: uint64_t, or a GCC vector of lanes
+// that runs one permutation per element
+#define KECCAK_F1600(name, T) \
+    static void name(T s[25]) { \
+        T a00 = s[0], a10 = s[1], a20 = s[2], a30 = s[3], a40 = s[4]; \
+        T a01 = s[5], a11 = s[6], a21 = s[7], a31 = s[8], a41 = s[9]; \
+        T a02 = s[10], a12 = s[11], a22 = s[12], a32 = s[13], a42 = s[14]; \
+        T a03 = s[15], a13 = s[16], a23 = s[17], a33 = s[18], a43 = s[19]; \
+        T a04 = s[20], a14 = s[21], a24 = s[22], a34 = s[23], a44 = s[24]; \
+        T b00, b10, b20, b30, b40, b01, b11, b21, b31, b41, b02, b12, b22, b32, b42; \
+        T b03, b13, b23, b33, b43, b04, b14, b24, b34, b44; \
+        T c0, c1, c2, c3, c4, d0, d1, d2, d3, d4; \
+        for (int round = 0; round < 24; round += 2) { \
+            KECCAK_ROUND(keccak_round_constants[round]); \
+            KECCAK_ROUND(keccak_round_constants[round + 1]); \
+        } \
+        s[0] = a00; s[1] = a10; s[2] = a20; s[3] = a30; s[4] = a40; \
+        s[5] = a01; s[6] = a11; s[7] = a21; s[8] = a31; s[9] = a41; \
+        s[10] = a02; s[11] = a12; s[12] = a22; s[13] = a32; s[14] = a42; \
+        s[15] = a03; s[16] = a13; s[17] = a23; s[18] = a33; s[19] = a43; \
+        s[20] = a04; s[21] = a14; s[22] = a24; s[23] = a34; s[24] = a44; \
+    }
+
+/// \brief Keccak-f[1600] on 25 little-endian lanes
+KECCAK_F1600(keccak_f1600, uint64_t)
+
+// Multi-buffer permutation: KECCAK_WAYS independent states, lane i of state w
+// in element w of s[i]. GCC lowers the vector operations to AVX-512 (8 ways)
+// or AVX2 (4 ways) when the target has them, e.g. with -march=native;
+// otherwise keccak256_batch() falls back to the scalar permutation.
+#if defined(__AVX512F__)
+#define KECCAK_WAYS 8
+#elif defined(__AVX2__)
+#define KECCAK_WAYS 4
+#else
+#define KECCAK_WAYS 1
+#endif
+
+#if KECCAK_WAYS > 1
+typedef uint64_t keccak_lanes __attribute__((vector_size(8 * KECCAK_WAYS)));
+
+KECCAK_F1600(keccak_f1600_ways, keccak_lanes)
+#endif
+
+#undef KECCAK_F1600
+#undef KECCAK_ROUND
+#undef KECCAK_ROL
+
+/// \brief Keccak-256 of len bytes
+static inline void keccak256_native(const uint8_t *in, size_t len, uint8_t out[32]) {
+    uint64_t s[25] = { 0 };
+    uint64_t lane;
+    for (; len >= KECCAK256_RATE; len -= KECCAK256_RATE, in += KECCAK256_RATE) {
+        for (int i = 0; i < KECCAK256_RATE / 8; i++) {
+            memcpy(&lane, in + 8 * i, 8);
+            s[i] ^= lane;
+        }
+        keccak_f1600(s);
+    }
+    uint8_t last[KECCAK256_RATE] = { 0 };
+    memcpy(last, in, len);
+    last[len] = 0x01;
+    last[KECCAK256_RATE - 1] |= 0x80;
+    for (int i = 0; i < KECCAK256_RATE / 8; i++) {
+        memcpy(&lane, last + 8 * i, 8);
+        s[i] ^= lane;
+    }
+    keccak_f1600(s);
+    memcpy(out, s, 32);
+}
+
+// Incremental sponge for data that arrives in pieces (step log records, page
+// fragments): keccak_init, any number of keccak_absorb calls, then
+// keccak_squeeze, which finalizes on its first call and can be called again
+// for more output. The result is the one Keccak() of keccak256-c.c gives for
+// the concatenated input, so keccak256_init matches Keccak_SHA256 and
+// sha3_256_init FIPS202_SHA3_256.
+struct KeccakSponge {
+    uint64_t s[25];
+    uint32_t rate;      // bytes, a multiple of 8 below 200
+    uint32_t pos;       // bytes absorbed into or squeezed from the current block
+    uint8_t suffix;
+    int squeezing;
+};
+
+static inline void keccak_init(struct KeccakSponge *k, uint32_t rate, uint8_t suffix) {
+    memset(k->s, 0, sizeof(k->s));
+    k->rate = rate;
+    k->pos = 0;
+    k->suffix = suffix;
+    k->squeezing = 0;
+}
+
+static inline void keccak256_init(struct KeccakSponge *k) {
+    keccak_init(k, KECCAK256_RATE, 0x01);
+}
+
+static inline void sha3_256_init(struct KeccakSponge *k) {
+    keccak_init(k, KECCAK256_RATE, 0x06);
+}
+
+/// \brief Absorbs len more bytes; not allowed once squeezing started
+static inline void keccak_absorb(struct KeccakSponge *k, const void *data, size_t len) {
+    const uint8_t *in = data;
+    uint8_t *bytes = (uint8_t *)k->s;
+    while (len > 0) {
+        if (k->pos == 0 && len >= k->rate) {
+            uint64_t lane;
+            for (uint32_t i = 0; i < k->rate / 8; i++) {
+                memcpy(&lane, in + 8 * i, 8);
+                k->s[i] ^= lane;
+            }
+            keccak_f1600(k->s);
+            in += k->rate;
+            len -= k->rate;
+            continue;
+        }
+        size_t n = k->rate - k->pos < len ? k->rate - k->pos : len;
+        for (size_t i = 0; i < n; i++) {
+            bytes[k->pos + i] ^= in[i];
+        }
+        in += n;
+        len -= n;
+        k->pos += n;
+        if (k->pos == k->rate) {
+            keccak_f1600(k->s);
+            k->pos = 0;
+        }
+    }
+}
+
+/// \brief Pads the absorbed input and switches to squeezing
+static inline void keccak_finalize(struct KeccakSponge *k) {
+    uint8_t *bytes = (uint8_t *)k->s;
+    bytes[k->pos] ^= k->suffix;
+    if ((k->suffix & 0x80) && k->pos == k->rate - 1) {
+        keccak_f1600(k->s);
+    }
+    bytes[k->rate - 1] ^= 0x80;
+    keccak_f1600(k->s);
+    k->pos = 0;
+    k->squeezing = 1;
+}
+
+/// \brief Writes the next len bytes of output
+static inline void keccak_squeeze(struct KeccakSponge *k, uint8_t *out, size_t len) {
+    if (!k->squeezing) {
+        keccak_finalize(k);
+    }
+    while (len > 0) {
+        if (k->pos == k->rate) {
+            keccak_f1600(k->s);
+            k->pos = 0;
+        }
+        size_t n = k->rate - k->pos < len ? k->rate - k->pos : len;
+        memcpy(out, (uint8_t *)k->s + k->pos, n);
+        out += n;
+        len -= n;
+        k->pos += n;
+    }
+}
+
+/// \brief Keccak-256 of one 8-byte word, as little-endian bytes (a Merkle leaf)
+static inline void keccak256_word(uint64_t word, uint8_t out[32]) {
+    uint64_t s[25] = { 0 };
+    s[0] = word;
+    s[1] = 0x01;
+    s[KECCAK256_RATE / 8 - 1] = 0x8000000000000000ULL;
+    keccak_f1600(s);
+    memcpy(out, s, 32);
+}
+
+/// \brief Keccak-256 of left || right (a Merkle node)
+static inline void keccak256_pair(const uint8_t left[32], const uint8_t right[32], uint8_t out[32]) {
+    uint64_t s[25] = { 0 };
+    memcpy(s, left, 32);
+    memcpy(s + 4, right, 32);
+    s[8] = 0x01;
+    s[KECCAK256_RATE / 8 - 1] = 0x8000000000000000ULL;
+    keccak_f1600(s);
+    memcpy(out, s, 32);
+}
+
+
+/// \brief Keccak-256 of n messages of len bytes each, in[i] hashed to out[i],
+/// KECCAK_WAYS messages per permutation
+static inline void keccak256_batch(const uint8_t *const *in, size_t len, uint8_t *const *out, size_t n) {
+    size_t i = 0;
+#if KECCAK_WAYS > 1
+    for (; i < n - n % KECCAK_WAYS; i += KECCAK_WAYS) {
+        const uint8_t *const *m = in + i;
+        keccak_lanes s[25] = { 0 };
+        uint64_t lane;
+        size_t off = 0;
+        for (; len - off >= KECCAK256_RATE; off += KECCAK256_RATE) {
+            for (int l = 0; l < KECCAK256_RATE / 8; l++) {
+                for (int w = 0; w < KECCAK_WAYS; w++) {
+                    memcpy(&lane, m[w] + off + 8 * l, 8);
+                    s[l][w] ^= lane;
+                }
+            }
+            keccak_f1600_ways(s);
+        }
+        for (int w = 0; w < KECCAK_WAYS; w++) {
+            uint8_t last[KECCAK256_RATE] = { 0 };
+            memcpy(last, m[w] + off, len - off);
+            last[len - off] = 0x01;
+            last[KECCAK256_RATE - 1] |= 0x80;
+            for (int l = 0; l < KECCAK256_RATE / 8; l++) {
+                memcpy(&lane, last + 8 * l, 8);
+                s[l][w] ^= lane;
+            }
+        }
+        keccak_f1600_ways(s);
+        for (int w = 0; w < KECCAK_WAYS; w++) {
+            for (int l = 0; l < 4; l++) {
+                lane = s[l][w];
+                memcpy(out[i + w] + 8 * l, &lane, 8);
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        keccak256_native(in[i], len, out[i]);
+    }
+}
+
+#endif
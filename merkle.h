@@ -0,0 +1,127 @@
+// Incremental Keccak256 Merkle tree over the StandardRAM.
+//
+// Include after rv64i.c (uses its integer types and RAM geometry). It is the
+// tree the RV64I_MERKLE circuit checks: RAM_SIZE / 8 leaves, leaf = Keccak256
+// of the word as 8 little-endian bytes, node = Keccak256(left || right).
+//
+// The nodes are stored as a heap, node 1 is the root and node
+// MERKLE_LEAVES + w the leaf of word w. Writes only mark their leaf dirty;
+// merkle_update() rehashes the dirty nodes one level at a time, so the paths
+// shared by the writes of a step are hashed once, and a step costs at most
+// (writes) * (RAM_WORD_BITS + 1) hashes instead of a rebuild. The nodes of a
+// level are hashed KECCAK_WAYS at a time (keccak256_batch), so build with
+// -march=native to use AVX2/AVX-512.
+//
+// struct MerkleTree *tree = malloc(sizeof(struct MerkleTree));
+// merkle_init(tree, ram);
+// merkle_apply_writes(tree, paddr, val, type, count);
+// const uint8 *root = merkle_update(tree);
+
+#include "keccak-native.h"
+
+#define MERKLE_LEAVES (RAM_SIZE / 8)
+
+struct MerkleTree {
+    uint8 node[2 * MERKLE_LEAVES][32];
+    uint64 word[MERKLE_LEAVES];
+    // nodes of one level waiting to be rehashed, each at most once
+    uint32 dirty[MERKLE_LEAVES];
+    uint32 dirty_count;
+    uint8 queued[2 * MERKLE_LEAVES];
+};
+
+/// \brief Hashes count nodes of one level, the nodes list[i], or first + i if list is NULL:
+/// a leaf from its word, an inner node from its two children (adjacent in the heap)
+static void merkle_hash_level(struct MerkleTree *tree, const uint32 *list, uint32 first, uint32 count) {
+    const uint8 *in[KECCAK_WAYS];
+    uint8 *out[KECCAK_WAYS];
+    uint32 n0 = list != NULL ? list[0] : first;
+    size_t len = n0 >= MERKLE_LEAVES ? 8 : 64;
+    for (uint32 i = 0; i < count; i += KECCAK_WAYS) {
+        uint32 m = count - i < KECCAK_WAYS ? count - i : KECCAK_WAYS;
+        for (uint32 j = 0; j < m; j++) {
+            uint32 n = list != NULL ? list[i + j] : first + i + j;
+            in[j] = n >= MERKLE_LEAVES ? (const uint8 *)&tree->word[n - MERKLE_LEAVES] : tree->node[2 * n];
+            out[j] = tree->node[n];
+        }
+        keccak256_batch(in, len, out, m);
+    }
+}
+
+/// \brief Builds the tree of ram (RAM_SIZE / 8 words)
+static void merkle_init(struct MerkleTree *tree, const uint64 *ram) {
+    memcpy(tree->word, ram, sizeof(tree->word));
+    for (uint32 level = MERKLE_LEAVES; level >= 1; level >>= 1) {
+        merkle_hash_level(tree, NULL, level, level);
+    }
+    tree->dirty_count = 0;
+    memset(tree->queued, 0, sizeof(tree->queued));
+}
+
+/// \brief Sets word w, the hashes are brought up to date by merkle_update()
+static inline void merkle_set(struct MerkleTree *tree, uint32 w, uint64 val) {
+    if (tree->word[w] == val) {
+        return;
+    }
+    tree->word[w] = val;
+    uint32 n = MERKLE_LEAVES + w;
+    if (!tree->queued[n]) {
+        tree->queued[n] = 1;
+        tree->dirty[tree->dirty_count++] = n;
+    }
+}
+
+/// \brief Applies the writes of an access log (0 read, 1 write, 2 end) to the tree;
+/// returns false, leaving the remaining writes unapplied, on a write outside the StandardRAM
+static inline bool merkle_apply_writes(struct MerkleTree *tree, const uint64 *paddr, const uint64 *val,
+    const uint8 *readWriteEnd, uint32 count) {
+    for (uint32 i = 0; i < count && readWriteEnd[i] != 2; i++) {
+        if (readWriteEnd[i] != 1) {
+            continue;
+        }
+        uint64 w = ramOffset(paddr[i]) / 8;
+        if (w >= MERKLE_LEAVES) {
+            return false;
+        }
+        merkle_set(tree, (uint32)w, val[i]);
+    }
+    return true;
+}
+
+/// \brief Rehashes the dirty paths level by level, returns the root
+static const uint8 *merkle_update(struct MerkleTree *tree) {
+    uint32 count = tree->dirty_count;
+    if (count > 0) {
+        merkle_hash_level(tree, tree->dirty, 0, count);
+    }
+    for (uint32 i = 0; i < count; i++) {
+        tree->queued[tree->dirty[i]] = 0;
+    }
+    // the dirty list holds one level at a time, so its first node tells when the root is done
+    while (count > 0 && tree->dirty[0] > 1) {
+        uint32 parents = 0;
+        for (uint32 i = 0; i < count; i++) {
+            uint32 p = tree->dirty[i] >> 1;
+            if (!tree->queued[p]) {
+                tree->queued[p] = 1;
+                tree->dirty[parents++] = p;
+            }
+        }
+        merkle_hash_level(tree, tree->dirty, 0, parents);
+        for (uint32 i = 0; i < parents; i++) {
+            tree->queued[tree->dirty[i]] = 0;
+        }
+        count = parents;
+    }
+    tree->dirty_count = 0;
+    return tree->node[1];
+}
+
+/// \brief Siblings of word w from the leaf up (RAM_WORD_BITS of them), as the
+/// access_siblings of MerkleBisectInput; call merkle_update() first
+static inline void merkle_siblings(const struct MerkleTree *tree, uint32 w, uint8 (*siblings)[32]) {
+    uint32 n = MERKLE_LEAVES + w;
+    for (int level = 0; n > 1; level++, n >>= 1) {
+        memcpy(siblings[level], tree->node[n ^ 1], 32);
+    }
+}
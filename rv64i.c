@@ -35,13 +35,47 @@ typedef uint64_t uint64;
 #define UPC 0x330
 #define UX0 0x340
 
+// Step circuit classes. The generic circuit (INSN_CLASS_ALL) executes every
+// instruction; building with -D INSN_CLASS=INSN_CLASS_xxx keeps only that
+// class and shrinks the access log to the most accesses a step of that class
+// performs (4 fetch reads + instruction + cycle write), plus the end marker.
+#define INSN_CLASS_ALL 0
+#define INSN_CLASS_ALU 1
+#define INSN_CLASS_BRANCH 2
+#define INSN_CLASS_LOAD 3
+#define INSN_CLASS_STORE 4
+#define INSN_CLASS_JUMP 5
+
+#ifndef INSN_CLASS
+#define INSN_CLASS INSN_CLASS_ALL
+#endif
+
+#ifndef ACCESS_LOG_SIZE
+#if INSN_CLASS == INSN_CLASS_ALU
+#define ACCESS_LOG_SIZE 10  // rs1, rs2, rd, pc
+#elif INSN_CLASS == INSN_CLASS_BRANCH
+#define ACCESS_LOG_SIZE 9   // rs1, rs2, pc
+#elif INSN_CLASS == INSN_CLASS_LOAD
+#define ACCESS_LOG_SIZE 10  // rs1, mem, rd, pc
+#elif INSN_CLASS == INSN_CLASS_STORE
+#define ACCESS_LOG_SIZE 11  // rs1, rs2, mem read, mem write, pc
+#elif INSN_CLASS == INSN_CLASS_JUMP
+#define ACCESS_LOG_SIZE 9   // rs1, rd, pc
+#else
+#define ACCESS_LOG_SIZE 16
+#endif
+#endif
 
 struct UarchState {
-    uint64 access_paddr[16];
-    uint64 access_val[16];
-    uint8 access_readWriteEnd[16];
+    uint64 access_paddr[ACCESS_LOG_SIZE];
+    uint64 access_val[ACCESS_LOG_SIZE];
+    uint8 access_readWriteEnd[ACCESS_LOG_SIZE];
     uint8 access_pointer;
     uint8 trap;
+#ifdef RV64I_NATIVE_RAM
+    uint64 *ram;        // a StandardRAM the accesses go to instead of the log, or NULL
+    bool record;        // and are also written to the log, up to ACCESS_LOG_SIZE
+#endif
 };
 
 typedef struct UarchState UarchState;
@@ -53,8 +87,35 @@ enum UArchStepStatus {
 };
 
 
+#ifdef RV64I_NATIVE_RAM
+// Native execution (not for the circuit): with a->ram set, readWord and
+// writeWord read and write that StandardRAM directly, so uarch_step runs a
+// uarch program at native speed instead of checking a given access log. An
+// access outside the StandardRAM traps with 19 or 21 like a log mismatch.
+static inline uint64 *nativeWord(UarchState *a, uint64 paddr, uint8 trap);
+
+static inline void nativeRecord(UarchState *a, uint64 paddr, uint64 val, uint8 readWriteEnd) {
+    if (a->access_pointer < ACCESS_LOG_SIZE) {
+        a->access_paddr[a->access_pointer] = paddr;
+        a->access_val[a->access_pointer] = val;
+        a->access_readWriteEnd[a->access_pointer] = readWriteEnd;
+    }
+    a->access_pointer++;
+}
+#endif
+
 static inline uint64 readWord(UarchState *a, uint64 paddr) {
-    if (a->access_pointer > 16) {
+#ifdef RV64I_NATIVE_RAM
+    if (a->ram != NULL) {
+        uint64 *word = nativeWord(a, paddr, 19);
+        uint64 val = word != NULL ? *word : 0;
+        if (a->record) {
+            nativeRecord(a, paddr, val, 0);
+        }
+        return val;
+    }
+#endif
+    if (a->access_pointer > ACCESS_LOG_SIZE) {
        a->trap = 18;
        return 0;
     }
@@ -69,7 +130,19 @@ static inline uint64 readWord(UarchState *a, uint64 paddr) {
 }
 
 static inline void writeWord(UarchState *a, uint64 paddr, uint64 val) {
-    if (a->access_pointer > 16) {
+#ifdef RV64I_NATIVE_RAM
+    if (a->ram != NULL) {
+        uint64 *word = nativeWord(a, paddr, 21);
+        if (word != NULL) {
+            *word = val;
+        }
+        if (a->record) {
+            nativeRecord(a, paddr, val, 1);
+        }
+        return;
+    }
+#endif
+    if (a->access_pointer > ACCESS_LOG_SIZE) {
        a->trap = 20;
        return;
     }
@@ -1048,110 +1121,244 @@ static inline bool insnMatchOpcodeFunct3Funct7Sr1(uint32 insn, uint32 opcode, ui
     return ((insn & mask)) == (uint32ShiftLeft(funct7Sr1, 26) | uint32ShiftLeft(funct3, 12) | opcode);
 }
 
-// Decode and execute one instruction
+/// \brief Returns the step circuit class of an instruction, or INSN_CLASS_ALL if it belongs to none
+static inline uint8 insnClass(uint32 insn) {
+    switch (insn & 0x7f) {
+    case 0x13: case 0x1b: case 0x33: case 0x3b: case 0x37: case 0x17: case 0xf:
+        return INSN_CLASS_ALU;
+    case 0x63:
+        return INSN_CLASS_BRANCH;
+    case 0x3:
+        return INSN_CLASS_LOAD;
+    case 0x23:
+        return INSN_CLASS_STORE;
+    case 0x6f: case 0x67:
+        return INSN_CLASS_JUMP;
+    }
+    return INSN_CLASS_ALL;
+}
 
-static inline void executeInsn(UarchState *a, uint32 insn, uint64 pc) {
+// Decode and execute one instruction, one class at a time.
+// Each returns false if the instruction is not in its class.
+static inline bool executeAluInsn(UarchState *a, uint32 insn, uint64 pc) {
     if (insnMatchOpcodeFunct3(insn, 0x13, 0x0)) {
-        return executeADDI(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x3)) {
-        return executeLD(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x6)) {
-        return executeBLTU(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x0)) {
-        return executeBEQ(a, insn, pc);
+        executeADDI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x13, 0x7)) {
-        return executeANDI(a, insn, pc);
+        executeANDI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x0, 0x0)) {
-        return executeADD(a, insn, pc);
-    } else if (insnMatchOpcode(insn, 0x6f)) {
-        return executeJAL(a, insn, pc);
+        executeADD(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7Sr1(insn, 0x13, 0x1, 0x0)) {
-        return executeSLLI(a, insn, pc);
+        executeSLLI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x7, 0x0)) {
-        return executeAND(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x3)) {
-        return executeSD(a, insn, pc);
+        executeAND(a, insn, pc);
+        return true;
     } else if (insnMatchOpcode(insn, 0x37)) {
-        return executeLUI(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x67, 0x0)) {
-        return executeJALR(a, insn, pc);
+        executeLUI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x1b, 0x0)) {
-        return executeADDIW(a, insn, pc);
+        executeADDIW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7Sr1(insn, 0x13, 0x5, 0x0)) {
-        return executeSRLI(a, insn, pc);
+        executeSRLI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x1b, 0x5, 0x0)) {
-        return executeSRLIW(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x1)) {
-        return executeBNE(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x2)) {
-        return executeLW(a, insn, pc);
+        executeSRLIW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcode(insn, 0x17)) {
-        return executeAUIPC(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x7)) {
-        return executeBGEU(a, insn, pc);
+        executeAUIPC(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x3b, 0x0, 0x0)) {
-        return executeADDW(a, insn, pc);
+        executeADDW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7Sr1(insn, 0x13, 0x5, 0x10)) {
-        return executeSRAI(a, insn, pc);
+        executeSRAI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x6, 0x0)) {
-        return executeOR(a, insn, pc);
+        executeOR(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x1b, 0x5, 0x20)) {
-        return executeSRAIW(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x5)) {
-        return executeBGE(a, insn, pc);
+        executeSRAIW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x0, 0x20)) {
-        return executeSUB(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x4)) {
-        return executeLBU(a, insn, pc);
+        executeSUB(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x1b, 0x1, 0x0)) {
-        return executeSLLIW(a, insn, pc);
+        executeSLLIW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x5, 0x0)) {
-        return executeSRL(a, insn, pc);
+        executeSRL(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x4, 0x0)) {
-        return executeXOR(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x2)) {
-       return executeSW(a, insn, pc);
+        executeXOR(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x1, 0x0)) {
-        return executeSLL(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x4)) {
-        return executeBLT(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x0)) {
-        return executeSB(a, insn, pc);
+        executeSLL(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x3b, 0x0, 0x20)) {
-        return executeSUBW(a, insn, pc);
+        executeSUBW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x13, 0x4)) {
-        return executeXORI(a, insn, pc);
+        executeXORI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x5, 0x20)) {
-        return executeSRA(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x5)) {
-        return executeLHU(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x1)) {
-        return executeSH(a, insn, pc);
+        executeSRA(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x3b, 0x5, 0x0)) {
-        return executeSRLW(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x6)) {
-        return executeLWU(a, insn, pc);
+        executeSRLW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x3b, 0x1, 0x0)) {
-        return executeSLLW(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x0)) {
-        return executeLB(a, insn, pc);
+        executeSLLW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x3, 0x0)) {
-        return executeSLTU(a, insn, pc);
+        executeSLTU(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x3b, 0x5, 0x20)) {
-        return executeSRAW(a, insn, pc);
-    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x1)) {
-        return executeLH(a, insn, pc);
+        executeSRAW(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x13, 0x6)) {
-        return executeORI(a, insn, pc);
+        executeORI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x13, 0x3)) {
-        return executeSLTIU(a, insn, pc);
+        executeSLTIU(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3Funct7(insn, 0x33, 0x2, 0x0)) {
-        return executeSLT(a, insn, pc);
+        executeSLT(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0x13, 0x2)) {
-        return executeSLTI(a, insn, pc);
+        executeSLTI(a, insn, pc);
+        return true;
     } else if (insnMatchOpcodeFunct3(insn, 0xf, 0x0)) {
-        return executeFENCE(a, insn, pc);
+        executeFENCE(a, insn, pc);
+        return true;
+    }
+    return false;
+}
+
+static inline bool executeBranchInsn(UarchState *a, uint32 insn, uint64 pc) {
+    if (insnMatchOpcodeFunct3(insn, 0x63, 0x6)) {
+        executeBLTU(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x0)) {
+        executeBEQ(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x1)) {
+        executeBNE(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x7)) {
+        executeBGEU(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x5)) {
+        executeBGE(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x63, 0x4)) {
+        executeBLT(a, insn, pc);
+        return true;
+    }
+    return false;
+}
+
+static inline bool executeLoadInsn(UarchState *a, uint32 insn, uint64 pc) {
+    if (insnMatchOpcodeFunct3(insn, 0x3, 0x3)) {
+        executeLD(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x2)) {
+        executeLW(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x4)) {
+        executeLBU(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x5)) {
+        executeLHU(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x6)) {
+        executeLWU(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x0)) {
+        executeLB(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x3, 0x1)) {
+        executeLH(a, insn, pc);
+        return true;
+    }
+    return false;
+}
+
+static inline bool executeStoreInsn(UarchState *a, uint32 insn, uint64 pc) {
+    if (insnMatchOpcodeFunct3(insn, 0x23, 0x3)) {
+        executeSD(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x2)) {
+        executeSW(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x0)) {
+        executeSB(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x23, 0x1)) {
+        executeSH(a, insn, pc);
+        return true;
+    }
+    return false;
+}
+
+static inline bool executeJumpInsn(UarchState *a, uint32 insn, uint64 pc) {
+    if (insnMatchOpcode(insn, 0x6f)) {
+        executeJAL(a, insn, pc);
+        return true;
+    } else if (insnMatchOpcodeFunct3(insn, 0x67, 0x0)) {
+        executeJALR(a, insn, pc);
+        return true;
+    }
+    return false;
+}
+
+
+static inline void executeInsn(UarchState *a, uint32 insn, uint64 pc) {
+#ifdef RV64I_NATIVE_RAM
+    // native execution runs every class, picked by the opcode, and decodes for itself
+    if (a->ram != NULL) {
+        bool done = false;
+        switch (insnClass(insn)) {
+        case INSN_CLASS_ALU: done = executeAluInsn(a, insn, pc); break;
+        case INSN_CLASS_BRANCH: done = executeBranchInsn(a, insn, pc); break;
+        case INSN_CLASS_LOAD: done = executeLoadInsn(a, insn, pc); break;
+        case INSN_CLASS_STORE: done = executeStoreInsn(a, insn, pc); break;
+        case INSN_CLASS_JUMP: done = executeJumpInsn(a, insn, pc); break;
+        }
+        if (!done) {
+            a->trap = 253;
+        }
+        return;
+    }
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL || INSN_CLASS == INSN_CLASS_ALU
+    if (executeAluInsn(a, insn, pc)) {
+        return;
+    }
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL || INSN_CLASS == INSN_CLASS_BRANCH
+    if (executeBranchInsn(a, insn, pc)) {
+        return;
+    }
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL || INSN_CLASS == INSN_CLASS_LOAD
+    if (executeLoadInsn(a, insn, pc)) {
+        return;
+    }
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL || INSN_CLASS == INSN_CLASS_STORE
+    if (executeStoreInsn(a, insn, pc)) {
+        return;
+    }
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL || INSN_CLASS == INSN_CLASS_JUMP
+    if (executeJumpInsn(a, insn, pc)) {
+        return;
     }
+#endif
     a->trap = 253;    
 //    throw std::runtime_error("illegal instruction");
 }
@@ -1178,9 +1385,9 @@ enum UArchStepStatus uarch_step(UarchState *a) {
 
 
 struct Input {
-    uint64 access_paddr[16];
-    uint64 access_val[16];
-    uint8 access_readWriteEnd[16];
+    uint64 access_paddr[ACCESS_LOG_SIZE];
+    uint64 access_val[ACCESS_LOG_SIZE];
+    uint8 access_readWriteEnd[ACCESS_LOG_SIZE];
 };
 
 typedef struct Input Input;
@@ -1189,7 +1396,10 @@ int rv64i(const Input input) {
    UarchState state;
    state.access_pointer = 0;
    state.trap = 0;
-   for (int i = 0; i < 16; i++) {
+#ifdef RV64I_NATIVE_RAM
+   state.ram = NULL;
+#endif
+   for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
       state.access_paddr[i] = input.access_paddr[i];
       state.access_val[i] = input.access_val[i];
       state.access_readWriteEnd[i] = input.access_readWriteEnd[i];
@@ -1202,7 +1412,7 @@ int rv64i(const Input input) {
      retval = state.trap;
    } else if (ret != Success) {
      retval = 1;
-   } else if (state.access_pointer > 16) {
+   } else if (state.access_pointer > ACCESS_LOG_SIZE) {
      retval = 16;
    } else if (state.access_readWriteEnd[state.access_pointer] != 2) {
      retval = 17;
@@ -1212,10 +1422,83 @@ int rv64i(const Input input) {
    return retval;
 }
 
-#define RAM_SIZE 8192
+// RAM geometry. A StandardRAM holds 2^RAM_WORD_BITS words: the register page
+// (addresses below PAGE_SIZE map to themselves) followed by the RAM windows,
+// in order, and zero padding up to RAM_SIZE. The default is one window of
+// RAM_SIZE - PAGE_SIZE bytes at RAM_START. Several or sparse pages are given
+// as a list of { start, size } pairs, e.g.
+// -D RAM_WORD_BITS=11 -D 'RAM_WINDOWS={{0x70000000,0x1000},{0x80000000,0x2000}}'
+// Accesses outside the page and the windows map to themselves as well, which
+// puts them out of range of the StandardRAM.
+#ifndef RAM_WORD_BITS
+#define RAM_WORD_BITS 10
+#endif
+#define RAM_SIZE (8 << RAM_WORD_BITS)
+#ifndef PAGE_SIZE
 #define PAGE_SIZE 1024
+#endif
+#ifndef RAM_START
 #define RAM_START 0x70000000
-#define RAM_END   0x70001C00
+#endif
+#define RAM_END (RAM_START + RAM_SIZE - PAGE_SIZE)
+#ifndef RAM_WINDOWS
+#define RAM_WINDOWS { { RAM_START, RAM_SIZE - PAGE_SIZE } }
+#endif
+
+struct RamWindow {
+   uint64 start;
+   uint64 size;
+};
+
+static const struct RamWindow ramWindows[] = RAM_WINDOWS;
+#define RAM_WINDOW_COUNT (sizeof(ramWindows) / sizeof(ramWindows[0]))
+
+/// \brief Byte offset of paddr in the StandardRAM
+static inline uint64 ramOffset(uint64 paddr) {
+   uint64 off = paddr;
+   uint64 base = PAGE_SIZE;
+   for (unsigned w = 0; w < RAM_WINDOW_COUNT; w++) {
+      if (paddr >= ramWindows[w].start && paddr < ramWindows[w].start + ramWindows[w].size) {
+         off = paddr - ramWindows[w].start + base;
+      }
+      base += ramWindows[w].size;
+   }
+   return off;
+}
+
+/// \brief Address of the StandardRAM byte offset off, inverse of ramOffset
+static inline uint64 ramAddress(uint64 off) {
+   uint64 paddr = off;
+   uint64 base = PAGE_SIZE;
+   for (unsigned w = 0; w < RAM_WINDOW_COUNT; w++) {
+      if (off >= base && off < base + ramWindows[w].size) {
+         paddr = off - base + ramWindows[w].start;
+      }
+      base += ramWindows[w].size;
+   }
+   return paddr;
+}
+
+/// \brief Whether paddr is in the register page or one of the RAM windows
+static inline bool ramContains(uint64 paddr) {
+   bool in = paddr < PAGE_SIZE;
+   for (unsigned w = 0; w < RAM_WINDOW_COUNT; w++) {
+      in = in || (paddr >= ramWindows[w].start && paddr < ramWindows[w].start + ramWindows[w].size);
+   }
+   return in;
+}
+
+#ifdef RV64I_NATIVE_RAM
+/// \brief The StandardRAM word of paddr for native execution, or NULL with the trap set
+static inline uint64 *nativeWord(UarchState *a, uint64 paddr, uint8 trap) {
+   uint64 word = ramOffset(paddr) / 8;
+   if (word >= RAM_SIZE / 8) {
+      a->trap = trap;
+      return NULL;
+   }
+   return &a->ram[word];
+}
+#endif
 
 /* struct MicroInput {
    uint64 ram[RAM_SIZE / 8];
@@ -1233,18 +1516,73 @@ int rv64i(const Input input) {
 }; */
 // has to match
 #define MAX_CYCLE 1024*1024*1024
-#define BISECTION_STEPS 30
 typedef uint64 StandardRAM[RAM_SIZE/8];
 
+// Dissection schedule. By default every round commits one state and the
+// rounds are the binary search over cycles [0, MAX_CYCLE] verify_bisection
+// has always replayed. With -D DISSECTION_ARITY=k (a power of two up to 64)
+// every round commits the k - 1 states that cut the open cycles into k parts
+// and the verifier answers how many of them, in order, it agrees with, so
+// 2^30 cycles take 30 / log2(k) rounds, rounded up (8-ary 10, 16-ary 8).
+// The rounds narrow at most k^rounds - 1 open cycles down to one step, so the
+// open cycles are [0, MAX_CYCLE - 2] there and every dispute over a step
+// before cycle MAX_CYCLE - 2 ends on one; the binary schedule's [0, MAX_CYCLE]
+// is two more and leaves a few disputes (around cycle 2^29) two cycles wide.
+#ifdef DISSECTION_ARITY
+#if DISSECTION_ARITY == 2
+#define BISECTION_STEPS 30
+#define DISSECTION_ANSWER_BITS 1
+#elif DISSECTION_ARITY == 4
+#define BISECTION_STEPS 15
+#define DISSECTION_ANSWER_BITS 2
+#elif DISSECTION_ARITY == 8
+#define BISECTION_STEPS 10
+#define DISSECTION_ANSWER_BITS 3
+#elif DISSECTION_ARITY == 16
+#define BISECTION_STEPS 8
+#define DISSECTION_ANSWER_BITS 4
+#elif DISSECTION_ARITY == 32
+#define BISECTION_STEPS 6
+#define DISSECTION_ANSWER_BITS 5
+#elif DISSECTION_ARITY == 64
+#define BISECTION_STEPS 5
+#define DISSECTION_ANSWER_BITS 6
+#else
+#error "DISSECTION_ARITY must be a power of two from 2 to 64"
+#endif
+#define DISSECTION_RIGHT (MAX_CYCLE - 2)
+#else
+#define DISSECTION_ARITY 2
+#define BISECTION_STEPS 30
+#define DISSECTION_ANSWER_BITS 1
+#define DISSECTION_RIGHT MAX_CYCLE
+#endif
+#define DISSECTION_POINTS (DISSECTION_ARITY - 1)
+
+// With BISECTION_SCHEDULE_PUBLIC the verifier's bisection answers are public
+// (as they are in the dispute itself), so both parties know which snapshots
+// the replay ends on. Only those two are inputs, the agreed one at index 0
+// and the disagreed one at index 1, and the circuit compares them at constant
+// positions instead of replaying the bisection and muxing over all of them.
+#ifdef BISECTION_SCHEDULE_PUBLIC
+#define BISECTION_SNAPSHOTS 2
+#define AGREE_SNAPSHOT 0
+#define DISAGREE_SNAPSHOT 1
+#else
+#define BISECTION_SNAPSHOTS (BISECTION_STEPS * DISSECTION_POINTS)
+#endif
+
 struct BisectInput
 {
    StandardRAM ram;
    StandardRAM ram_disagree;
-   StandardRAM prover_bisection_RAM[BISECTION_STEPS];
-   uint64 access_paddr[16];
-   uint64 access_val[16];
-   uint8 access_readWriteEnd[16];
+   StandardRAM prover_bisection_RAM[BISECTION_SNAPSHOTS];
+   uint64 access_paddr[ACCESS_LOG_SIZE];
+   uint64 access_val[ACCESS_LOG_SIZE];
+   uint8 access_readWriteEnd[ACCESS_LOG_SIZE];
+#ifndef BISECTION_SCHEDULE_PUBLIC
    uint8 verifier_bisections[BISECTION_STEPS];
+#endif
    uint16 pad;
 };
 
@@ -1264,10 +1602,126 @@ struct MicroOutput {
           dst[i+7] = src[i+7]; } \
         } while (0)
 
+// Packed input layout. Every access lives in the register area below
+// PAGE_SIZE or in one of the RAM windows, i.e. in one of the RAM_SIZE / 8
+// words of a StandardRAM, so a slot is that word index (bits 0 up to
+// RAM_WORD_BITS) plus the read/write/end tag (bits 14-15) in 16 bits instead
+// of 64 + 8. The bisection answers are DISSECTION_ANSWER_BITS per round and the pad is gone.
+// rv64i: 136 -> 80 bits per slot, 2176 -> 1280 input bits (16 slots).
+// mpc_main: 2432 -> 1312 bits outside the RAM snapshots.
+#define PACKED_WORD_MASK ((1 << RAM_WORD_BITS) - 1)
+#define PACKED_TAG_SHIFT 14
+#if defined(RV64I_PACKED_INPUT) && RAM_WORD_BITS > PACKED_TAG_SHIFT
+#error "RAM_WORD_BITS too large for the packed slot layout"
+#endif
+
+struct PackedInput {
+   uint16 access_slot[ACCESS_LOG_SIZE];
+   uint64 access_val[ACCESS_LOG_SIZE];
+};
+
+struct PackedBisectInput
+{
+   StandardRAM ram;
+   StandardRAM ram_disagree;
+   StandardRAM prover_bisection_RAM[BISECTION_SNAPSHOTS];
+   uint16 access_slot[ACCESS_LOG_SIZE];
+   uint64 access_val[ACCESS_LOG_SIZE];
+#ifndef BISECTION_SCHEDULE_PUBLIC
+   uint32 verifier_bisections;
+#endif
+};
+
+static inline uint64 unpackPaddr(uint16 slot) {
+   return ramAddress((uint64)(slot & PACKED_WORD_MASK) * 8);
+}
+
+static inline uint8 unpackTag(uint16 slot) {
+   return slot >> PACKED_TAG_SHIFT;
+}
+
+struct Input unpackInput(const struct PackedInput in) {
+   struct Input out;
+   for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+      out.access_paddr[i] = unpackPaddr(in.access_slot[i]);
+      out.access_val[i] = in.access_val[i];
+      out.access_readWriteEnd[i] = unpackTag(in.access_slot[i]);
+   }
+   return out;
+}
+
+struct BisectInput unpackBisectInput(const struct PackedBisectInput in) {
+   struct BisectInput out;
+   COPY_RAM(in.ram, out.ram);
+   COPY_RAM(in.ram_disagree, out.ram_disagree);
+   for (int j = 0; j < BISECTION_SNAPSHOTS; j++) {
+      COPY_RAM(in.prover_bisection_RAM[j], out.prover_bisection_RAM[j]);
+   }
+#ifndef BISECTION_SCHEDULE_PUBLIC
+   for (int j = 0; j < BISECTION_STEPS; j++) {
+      out.verifier_bisections[j] = (in.verifier_bisections >> (j * DISSECTION_ANSWER_BITS)) & ((1 << DISSECTION_ANSWER_BITS) - 1);
+   }
+#endif
+   for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+      out.access_paddr[i] = unpackPaddr(in.access_slot[i]);
+      out.access_val[i] = in.access_val[i];
+      out.access_readWriteEnd[i] = unpackTag(in.access_slot[i]);
+   }
+   out.pad = 0;
+   return out;
+}
+
+/// \brief Packs one access log slot, returns false if paddr is not a word of
+/// the register area or RAM window, or the tag is not read/write/end
+static inline bool packSlot(uint64 paddr, uint8 tag, uint16 *slot) {
+   if (!ramContains(paddr)) {
+      return false;
+   }
+   uint64 off = ramOffset(paddr);
+   if ((off & 7) != 0 || tag > 2) {
+      return false;
+   }
+   *slot = (uint16)((off / 8) | ((uint16)tag << PACKED_TAG_SHIFT));
+   return true;
+}
+
+/// \brief Packs an access log, returns false if some slot cannot be packed
+static inline bool packInput(const struct Input *in, struct PackedInput *out) {
+   for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+      if (!packSlot(in->access_paddr[i], in->access_readWriteEnd[i], &out->access_slot[i])) {
+         return false;
+      }
+      out->access_val[i] = in->access_val[i];
+   }
+   return true;
+}
+
+static inline bool packBisectInput(const struct BisectInput *in, struct PackedBisectInput *out) {
+   memcpy(out->ram, in->ram, sizeof(StandardRAM));
+   memcpy(out->ram_disagree, in->ram_disagree, sizeof(StandardRAM));
+   memcpy(out->prover_bisection_RAM, in->prover_bisection_RAM, sizeof(in->prover_bisection_RAM));
+#ifndef BISECTION_SCHEDULE_PUBLIC
+   out->verifier_bisections = 0;
+   for (int j = 0; j < BISECTION_STEPS; j++) {
+      if (in->verifier_bisections[j] > DISSECTION_POINTS) {
+         return false;
+      }
+      out->verifier_bisections |= (uint32)in->verifier_bisections[j] << (j * DISSECTION_ANSWER_BITS);
+   }
+#endif
+   for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+      if (!packSlot(in->access_paddr[i], in->access_readWriteEnd[i], &out->access_slot[i])) {
+         return false;
+      }
+      out->access_val[i] = in->access_val[i];
+   }
+   return true;
+}
+
 
 int sanityCheck(const struct Input input) {
     int ret = 0;
-    for (int i = 0; i < 16; i++) {
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
          if (input.access_readWriteEnd[i] == 0) {
                // to save circuit space we don't allow reads of previously written during step
                for (int j = 0; j < i; j++) {
@@ -1280,6 +1734,40 @@ int sanityCheck(const struct Input input) {
     return ret;
 }
 
+// uarch_step always starts with the cycle, halt flag, pc and instruction
+// reads, and performs at least the pc and cycle writes. Every log rv64i()
+// accepts therefore has reads in slots 0-3 and its end marker at slot 6 or
+// later, and no step reads after it writes, so the only reads sanityCheck
+// can flag sit past the end marker (slot 7 on) and can only alias writes
+// from slot 4 on.
+#define SANITY_FIRST_WRITE_SLOT 4
+#define SANITY_FIRST_READ_SLOT 7
+
+/// \brief Same result as sanityCheck on every log rv64i() accepts, with the
+/// comparisons restricted to slot pairs that can alias (63 instead of 120
+/// for 16 slots). run_step only uses the result together with rv64i().
+int sanityCheckScheduled(const struct Input input) {
+    int ret = 0;
+    for (int i = SANITY_FIRST_READ_SLOT; i < ACCESS_LOG_SIZE; i++) {
+         if (input.access_readWriteEnd[i] == 0) {
+               for (int j = SANITY_FIRST_WRITE_SLOT; j < i; j++) {
+                   if (input.access_paddr[j] == input.access_paddr[i] && input.access_readWriteEnd[j] == 1) {
+                      ret = 1;
+                   }
+               }
+         }
+    }
+    return ret;
+}
+
+#ifdef SANITY_CHECK_EQUIVALENCE
+// cbmc rv64i.c -D SANITY_CHECK_EQUIVALENCE --function sanityCheckEquivalence
+void sanityCheckEquivalence(const struct Input input) {
+    __CPROVER_assert(rv64i(input) != 0 || sanityCheckScheduled(input) == sanityCheck(input),
+        "sanityCheckScheduled matches sanityCheck on every accepted log");
+}
+#endif
+
 struct MicroOutput ramPlusState(const struct BisectInput input) {
         struct MicroOutput output;
 	uint64 ret;
@@ -1289,23 +1777,15 @@ struct MicroOutput ramPlusState(const struct BisectInput input) {
             output.delta[j] = 0;
         }
         
-	for (int i = 0; i < 16; i++) {
+	for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
 	        if (input.access_readWriteEnd[i] == 0) {
-  	          uint64 off = input.access_paddr[i];
-	          if (off >= RAM_START && off < RAM_END) {
-	            off -= RAM_START;
-	            off += PAGE_SIZE;
-	          }
+  	          uint64 off = ramOffset(input.access_paddr[i]);
 	          off /= 8;
                   if (input.access_val[i] != input.ram[off]) {
                      ret = 432;
                   }
 	        } else if (input.access_readWriteEnd[i] == 1) {
-  	          uint64 off = input.access_paddr[i];
-	          if (off >= RAM_START && off < RAM_END) {
-	            off -= RAM_START;
-	            off += PAGE_SIZE;
-	          }
+  	          uint64 off = ramOffset(input.access_paddr[i]);
 	          off /= 8;
 	          output.delta[off] = input.ram[off] ^ input.access_val[i];
                 }
@@ -1408,6 +1888,44 @@ uint64 compareRAM_disagree_bisect(const struct BisectInput input, int agree) {
     return ok == 1 ? 1 : 0;
 }
 
+#ifdef BISECTION_SCHEDULE_PUBLIC
+uint64 compareRAM_agree_public(const struct BisectInput input) {
+    uint8 ok = 1;
+    
+    for (int i = 0; i < RAM_SIZE / 8; i += 8) {
+        uint8 a = input.ram[i] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i];
+        uint8 b = input.ram[i+1] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+1];
+        uint8 c = input.ram[i+2] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+2];
+        uint8 d = input.ram[i+3] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+3];
+        uint8 e = input.ram[i+4] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+4];
+        uint8 f = input.ram[i+5] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+5];
+        uint8 g = input.ram[i+6] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+6];
+        uint8 h = input.ram[i+7] == input.prover_bisection_RAM[AGREE_SNAPSHOT][i+7];
+        
+        ok = ok && a && b && c && d && e && f && g && h;
+    }
+    return ok == 1 ? 1 : 0;
+}
+
+uint64 compareRAM_disagree_public(const struct BisectInput input) {
+    uint8 ok = 1;
+    
+    for (int i = 0; i < RAM_SIZE / 8; i += 8) {
+        uint8 a = input.ram_disagree[i] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i];
+        uint8 b = input.ram_disagree[i+1] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+1];
+        uint8 c = input.ram_disagree[i+2] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+2];
+        uint8 d = input.ram_disagree[i+3] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+3];
+        uint8 e = input.ram_disagree[i+4] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+4];
+        uint8 f = input.ram_disagree[i+5] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+5];
+        uint8 g = input.ram_disagree[i+6] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+6];
+        uint8 h = input.ram_disagree[i+7] == input.prover_bisection_RAM[DISAGREE_SNAPSHOT][i+7];
+        
+        ok = ok && a && b && c && d && e && f && g && h;
+    }
+    return ok == 1 ? 1 : 0;
+}
+#endif
+
 uint64 compareRAMDelta(const struct BisectInput input, const struct MicroOutput delta) {
     uint8 ok = 1;
     
@@ -1450,18 +1968,106 @@ int access_and_compare(const struct BisectInput input) {
 
 
 
-int run_step(struct BisectInput input) {
+// Sparse form of access_and_compare: checks ram_disagree against ram plus
+// the logged writes without building a RAM-sized delta. Each read has to
+// match ram, the last write to a word has to match ram_disagree, and every
+// word no write touches has to be equal in both. That is one word selection
+// per read or last write and a single equal-or-touched pass over the RAM,
+// instead of a read, a RAM-sized delta write per slot and a delta compare.
+// Relies on what rv64i() checks, which run_step requires as well: slots
+// 0-2 are the reads of UCYCLE, UHALT and UPC (selected at constant words)
+// and nothing before SANITY_FIRST_WRITE_SLOT is a write.
+#define SPARSE_FIXED_SLOTS 3
+
+int access_and_compare_sparse(const struct BisectInput input) {
+    static const uint64 fixed_word[SPARSE_FIXED_SLOTS] = { UCYCLE / 8, UHALT / 8, UPC / 8 };
+    uint64 word[ACCESS_LOG_SIZE];
+    uint8 read[ACCESS_LOG_SIZE];
+    uint8 write[ACCESS_LOG_SIZE];
+    uint8 ended = 0;
+    uint8 ok = 1;
+
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+        ended = ended || input.access_readWriteEnd[i] == 2;
+        read[i] = !ended && input.access_readWriteEnd[i] == 0;
+        write[i] = !ended && i >= SANITY_FIRST_WRITE_SLOT && input.access_readWriteEnd[i] == 1;
+        uint64 off = ramOffset(input.access_paddr[i]) / 8;
+        if ((read[i] || write[i]) && off >= RAM_SIZE / 8) {
+            ok = 0;
+        }
+        word[i] = i < SPARSE_FIXED_SLOTS ? fixed_word[i] : off % (RAM_SIZE / 8);
+    }
+
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+        if (read[i] && input.ram[word[i]] != input.access_val[i]) {
+            ok = 0;
+        }
+        if (i >= SANITY_FIRST_WRITE_SLOT) {
+            uint8 last = write[i];
+            for (int k = i + 1; k < ACCESS_LOG_SIZE; k++) {
+                if (write[k] && word[k] == word[i]) {
+                    last = 0;
+                }
+            }
+            if (last && input.ram_disagree[word[i]] != input.access_val[i]) {
+                ok = 0;
+            }
+        }
+    }
+
+    for (uint64 j = 0; j < RAM_SIZE / 8; j++) {
+        uint8 touched = 0;
+        for (int i = SANITY_FIRST_WRITE_SLOT; i < ACCESS_LOG_SIZE; i++) {
+            touched = touched || (write[i] && word[i] == j);
+        }
+        if (!touched && input.ram[j] != input.ram_disagree[j]) {
+            ok = 0;
+        }
+    }
+#ifdef RV64I_VERBOSE
+    if (ok == 0) {
+        printf("sparse compare failed\n");
+    }
+#endif
+    return ok == 1 ? 1 : 0;
+}
+
+struct Input stepInput(const struct BisectInput input) {
         struct Input rv64_input;
-	for (int i = 0; i < 16; i++) {
+	for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
 		/* micro_input.access_paddr[i] = */ rv64_input.access_paddr[i] = input.access_paddr[i];
 		/* micro_input.access_val[i] = */ rv64_input.access_val[i] = input.access_val[i];
 		/* micro_input.access_readWriteEnd[i] =  */  rv64_input.access_readWriteEnd[i] = input.access_readWriteEnd[i];
 	} 
-	uint64 compare_result = access_and_compare(input);
+	return rv64_input;
+}
+
+#ifdef ACCESS_COMPARE_EQUIVALENCE
+// cbmc rv64i.c -D ACCESS_COMPARE_EQUIVALENCE --function accessCompareEquivalence
+void accessCompareEquivalence(const struct BisectInput input) {
+    // access_and_compare indexes the RAM without a range check and does not
+    // stop at the end marker, so keep every slot in range and after the end
+    // marker an end marker too
+    uint8 ended = 0;
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+        __CPROVER_assume(ramContains(input.access_paddr[i]));
+        __CPROVER_assume(!ended || input.access_readWriteEnd[i] == 2);
+        ended = ended || input.access_readWriteEnd[i] == 2;
+    }
+    struct Input rv64_input = stepInput(input);
+    __CPROVER_assert(rv64i(rv64_input) != 0 || sanityCheckScheduled(rv64_input) != 0
+        || access_and_compare_sparse(input) == access_and_compare(input),
+        "access_and_compare_sparse matches access_and_compare on every accepted log");
+}
+#endif
+
+int run_step(struct BisectInput input) {
+        struct Input rv64_input = stepInput(input);
+	uint64 compare_result = access_and_compare_sparse(input);
 #ifdef RV64I_VERBOSE
         printf("compare_result: %i\n", compare_result);
 #endif
-        uint64 sanity_check = sanityCheck(rv64_input);
+        uint64 sanity_check = sanityCheckScheduled(rv64_input);
 #ifdef RV64I_VERBOSE
         printf("sanity_check: %i\n", sanity_check);
 #endif
@@ -1474,46 +2080,326 @@ int run_step(struct BisectInput input) {
         return compare_result == 1 && sanity_check == 0 && rv64i_result == 0 ? 0 : 1;
 }
 
-int mpc_main(struct BisectInput input) {
+/// \brief Cycle of point j (1 .. DISSECTION_POINTS) of a round over the open cycles
+/// [left, right]: left - 1 + j * (right - left + 2) / k, (left + right) / 2 for k = 2
+static inline int dissectionPoint(int left, int right, int j) {
+	return (int)(((int64)(DISSECTION_ARITY - j) * left + (int64)j * right + 2 * j - DISSECTION_ARITY) / DISSECTION_ARITY);
+}
+
+#ifndef BISECTION_SCHEDULE_PUBLIC
+// replays the dissection and returns which prover snapshots are the last
+// agreed and the first disagreed state; round i commits the snapshots from
+// i * DISSECTION_POINTS on, in cycle order
+static void bisectionSnapshots(const uint8 *verifier_bisections, int *agree_ram, int *disagree_ram) {
 	int left = 0;
-	int right = MAX_CYCLE;
+	int right = DISSECTION_RIGHT;
 	int lastAgree = 0;
 	int lastDisagree = MAX_CYCLE;
-	int prover_bisection_cycle[BISECTION_STEPS];
+	int prover_bisection_cycle[BISECTION_SNAPSHOTS];
 
 	for (int i = 0; i < BISECTION_STEPS; i++) {
-		int mid = (left + right) / 2;
-		prover_bisection_cycle[i] = mid;
-		if (input.verifier_bisections[i] == 1) {
-			lastAgree = mid;
-			left = mid + 1;
-		} else {
-			lastDisagree = mid;
-			right = mid - 1;
+		// points agreed with, an out of range answer agrees with none
+		int agreed = verifier_bisections[i] <= DISSECTION_POINTS ? verifier_bisections[i] : 0;
+		int agreePoint = lastAgree;
+		int disagreePoint = lastDisagree;
+		for (int j = 1; j <= DISSECTION_POINTS; j++) {
+			int point = dissectionPoint(left, right, j);
+			prover_bisection_cycle[i * DISSECTION_POINTS + j - 1] = point;
+			if (j == agreed) {
+				agreePoint = point;
+			}
+			if (j == agreed + 1) {
+				disagreePoint = point;
+			}
 		}
-	}  
-	int agree_ram = 0, disagree_ram = 0;
-	for (int i = 0; i < BISECTION_STEPS; i++) {
+		if (agreed > 0) {
+			lastAgree = agreePoint;
+			left = agreePoint + 1;
+		}
+		if (agreed < DISSECTION_POINTS) {
+			lastDisagree = disagreePoint;
+			right = disagreePoint - 1;
+		}
+	}
+	*agree_ram = 0;
+	*disagree_ram = 0;
+	for (int i = 0; i < BISECTION_SNAPSHOTS; i++) {
 		if (prover_bisection_cycle[i] == lastAgree) {
-			agree_ram = i;
+			*agree_ram = i;
 		}
 	}
-	for (int i = 0; i < BISECTION_STEPS; i++) {
+	for (int i = 0; i < BISECTION_SNAPSHOTS; i++) {
 		if (prover_bisection_cycle[i] == lastDisagree) {
-			disagree_ram = i;
+			*disagree_ram = i;
 		}
 	}
+}
+#endif
+
+int verify_bisection(struct BisectInput input) {
+#ifdef BISECTION_SCHEDULE_PUBLIC
+        int ret = compareRAM_agree_public(input) == 1;
+
+        ret = ret && (compareRAM_disagree_public(input) == 1);
+#else
+	int agree_ram, disagree_ram;
+	bisectionSnapshots(input.verifier_bisections, &agree_ram, &disagree_ram);
 #ifdef RV64I_VERBOSE
        printf("agree_ram: %i disagree_ram: %i\n", agree_ram, disagree_ram);
 #endif
         int ret = compareRAM_agree_bisect(input, agree_ram) == 1;
         
         ret = ret && (compareRAM_disagree_bisect(input, disagree_ram) == 1);
+#endif
 #ifdef RV64I_VERBOSE
         if (ret == 0) {
            printf("comparing agree/bisect failed\n");
         }
 #endif  
-        return ret && run_step(input);
+        return ret && run_step(input) == 0 ? 0 : 1;
 }
 
+#ifdef RV64I_MERKLE
+// Commitment variant of verify_bisection: the prover snapshots are Keccak256
+// Merkle roots of the StandardRAM instead of the StandardRAM itself, and the
+// step is checked on the Merkle paths of the logged accesses only.
+//
+// The leaves are the RAM_SIZE / 8 words of the StandardRAM, leaf = Keccak256
+// of the word as 8 little-endian bytes, node = Keccak256(left || right), the
+// same hashing as the machine's own proofs (log2_target_size 3).
+#include "keccak256-c.c"
+
+#define MERKLE_DEPTH RAM_WORD_BITS
+typedef uint8 MerkleHash[32];
+
+struct MerkleBisectInput
+{
+   MerkleHash root;
+   MerkleHash root_disagree;
+   MerkleHash prover_bisection_root[BISECTION_SNAPSHOTS];
+   uint64 access_paddr[ACCESS_LOG_SIZE];
+   uint64 access_val[ACCESS_LOG_SIZE];
+   uint8 access_readWriteEnd[ACCESS_LOG_SIZE];
+   // word before a write, ignored for reads
+   uint64 access_prev_val[ACCESS_LOG_SIZE];
+   // siblings from the leaf up, against the root before the access
+   MerkleHash access_siblings[ACCESS_LOG_SIZE][MERKLE_DEPTH];
+#ifndef BISECTION_SCHEDULE_PUBLIC
+   uint8 verifier_bisections[BISECTION_STEPS];
+#endif
+   uint16 pad;
+};
+
+static inline void merkleLeaf(uint64 val, uint8 *out) {
+   uint8 word[8];
+   for (int i = 0; i < 8; i++) {
+      word[i] = (uint8)(val >> (i * 8));
+   }
+   Keccak(1088, 512, word, 8, 0x01, out, 32);
+}
+
+// root of the tree with val at word, given the siblings of its path
+static void merklePathRoot(uint64 val, uint64 word, const MerkleHash *siblings, uint8 *out) {
+   uint8 node[64];
+   uint8 h[32];
+   merkleLeaf(val, h);
+   for (int level = 0; level < MERKLE_DEPTH; level++) {
+      uint8 right = (word >> level) & 1;
+      for (int i = 0; i < 32; i++) {
+         node[i] = right ? siblings[level][i] : h[i];
+         node[32 + i] = right ? h[i] : siblings[level][i];
+      }
+      Keccak(1088, 512, node, 64, 0x01, h, 32);
+   }
+   for (int i = 0; i < 32; i++) {
+      out[i] = h[i];
+   }
+}
+
+static inline uint64 compareRoot(const uint8 *a, const uint8 *b) {
+   return COMPARE_BYTES32(a, b) ? 1 : 0;
+}
+
+// The slots a step rv64i() accepts can use, for the INSN_CLASS built: it reads
+// UCYCLE, UHALT, UPC and the instruction first; branches, loads and stores
+// read two more words (rs1 and rs2, or rs1 and the memory word) before they
+// write; the longest step is a sub-word store (the four reads, rs1, rs2, the
+// word read and write, pc and cycle), the class circuits have a log of
+// exactly their longest step and the end marker. Only the slots from
+// MERKLE_FIRST_WRITE_SLOT to MERKLE_LIVE_SLOTS - 1 hash a second path.
+#if INSN_CLASS == INSN_CLASS_BRANCH || INSN_CLASS == INSN_CLASS_LOAD || INSN_CLASS == INSN_CLASS_STORE
+#define MERKLE_FIRST_WRITE_SLOT 6
+#else
+#define MERKLE_FIRST_WRITE_SLOT SANITY_FIRST_WRITE_SLOT
+#endif
+#if INSN_CLASS == INSN_CLASS_ALL && ACCESS_LOG_SIZE > 10
+#define MERKLE_LIVE_SLOTS 10
+#else
+#define MERKLE_LIVE_SLOTS (ACCESS_LOG_SIZE - 1)
+#endif
+
+// root of the tree with the values of slots 0-2 at UCYCLE, UHALT and UPC,
+// hashed as one multiproof: the three words share all levels above the
+// second, so that is 14 Keccak-f instead of 33. The siblings are taken from
+// the paths of the slots, the ones of the other fixed words are not used.
+static void merkleFixedRoot(const struct MerkleBisectInput *input, uint8 *out) {
+   static const uint64 fixed_word[SPARSE_FIXED_SLOTS] = { UCYCLE / 8, UHALT / 8, UPC / 8 };
+   uint8 h[SPARSE_FIXED_SLOTS][32];
+   uint64 node[SPARSE_FIXED_SLOTS];
+   uint8 merged[SPARSE_FIXED_SLOTS];
+   uint8 pair[64];
+   for (int k = 0; k < SPARSE_FIXED_SLOTS; k++) {
+      merkleLeaf(input->access_val[k], h[k]);
+      node[k] = fixed_word[k];
+      merged[k] = 0;
+   }
+   // node, merged and the pairing are constants, only the hashes are circuit
+   for (int level = 0; level < MERKLE_DEPTH; level++) {
+      for (int k = 0; k < SPARSE_FIXED_SLOTS; k++) {
+         if (merged[k]) {
+            continue;
+         }
+         // a later slot whose node is the sibling of this one joins it here
+         int other = -1;
+         for (int j = k + 1; j < SPARSE_FIXED_SLOTS; j++) {
+            if (!merged[j] && node[j] == (node[k] ^ 1)) {
+               other = j;
+            }
+         }
+         uint8 right = node[k] & 1;
+         for (int i = 0; i < 32; i++) {
+            uint8 sibling = other >= 0 ? h[other][i] : input->access_siblings[k][level][i];
+            pair[i] = right ? sibling : h[k][i];
+            pair[32 + i] = right ? h[k][i] : sibling;
+         }
+         if (other >= 0) {
+            merged[other] = 1;
+         }
+         Keccak(1088, 512, pair, 64, 0x01, h[k], 32);
+      }
+      for (int k = 0; k < SPARSE_FIXED_SLOTS; k++) {
+         node[k] >>= 1;
+      }
+   }
+   for (int i = 0; i < 32; i++) {
+      out[i] = h[0][i];
+   }
+}
+
+// Merkle counterpart of access_and_compare: walks the access log from root,
+// checking each read and the previous value of each write against the
+// current root and moving the root on with each write, and returns 1 if it
+// ends at root_disagree. Reads after writes see the written value, so this
+// needs no sanityCheckScheduled. Like access_and_compare_sparse it relies on
+// what rv64i() checks, which run_step_merkle requires as well: slots 0-2 are
+// the reads of UCYCLE, UHALT and UPC, checked together by merkleFixedRoot,
+// writes sit between MERKLE_FIRST_WRITE_SLOT and MERKLE_LIVE_SLOTS, and the
+// log has ended by MERKLE_LIVE_SLOTS.
+int merkle_access_and_compare(const struct MerkleBisectInput input) {
+   uint8 root[32];
+   uint8 path[32];
+   uint8 ok = 1;
+   uint8 ended = 0;
+   for (int i = 0; i < 32; i++) {
+      root[i] = input.root[i];
+   }
+   merkleFixedRoot(&input, path);
+   if (compareRoot(path, root) == 0) {
+      ok = 0;
+   }
+   for (int i = 0; i < SPARSE_FIXED_SLOTS; i++) {
+      if (input.access_readWriteEnd[i] != 0) {
+         ok = 0;
+      }
+   }
+   for (int i = SPARSE_FIXED_SLOTS; i < ACCESS_LOG_SIZE && i < MERKLE_LIVE_SLOTS; i++) {
+      uint8 type = input.access_readWriteEnd[i];
+      ended = ended || type == 2;
+      uint64 off = ramOffset(input.access_paddr[i]) / 8;
+      if (!ended && off >= RAM_SIZE / 8) {
+         ok = 0;
+      }
+      uint8 write = i >= MERKLE_FIRST_WRITE_SLOT && type == 1;
+      merklePathRoot(write ? input.access_prev_val[i] : input.access_val[i], off, input.access_siblings[i], path);
+      if (!ended && compareRoot(path, root) == 0) {
+         ok = 0;
+      }
+      if (i >= MERKLE_FIRST_WRITE_SLOT) {
+         merklePathRoot(input.access_val[i], off, input.access_siblings[i], path);
+         if (!ended && write) {
+            for (int j = 0; j < 32; j++) {
+               root[j] = path[j];
+            }
+         }
+      } else if (!ended && type == 1) {
+         ok = 0;
+      }
+#ifdef RV64I_VERBOSE
+      if (ok == 0) {
+         printf("merkle proof of access %i failed\n", i);
+      }
+#endif
+   }
+   return ok == 1 && compareRoot(root, input.root_disagree) == 1 ? 1 : 0;
+}
+
+int run_step_merkle(const struct MerkleBisectInput input) {
+        struct Input rv64_input;
+	for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+		rv64_input.access_paddr[i] = input.access_paddr[i];
+		rv64_input.access_val[i] = input.access_val[i];
+		rv64_input.access_readWriteEnd[i] = input.access_readWriteEnd[i];
+	}
+	uint64 compare_result = merkle_access_and_compare(input);
+#ifdef RV64I_VERBOSE
+        printf("compare_result: %i\n", compare_result);
+#endif
+        uint64 rv64i_result = rv64i(rv64_input);
+#ifdef RV64I_VERBOSE
+        printf("rv64i_result: %i\n", rv64i_result);
+#endif
+        return compare_result == 1 && rv64i_result == 0 ? 0 : 1;
+}
+
+int verify_bisection_merkle(struct MerkleBisectInput input) {
+	int agree_ram, disagree_ram;
+#ifdef BISECTION_SCHEDULE_PUBLIC
+	agree_ram = AGREE_SNAPSHOT;
+	disagree_ram = DISAGREE_SNAPSHOT;
+#else
+	bisectionSnapshots(input.verifier_bisections, &agree_ram, &disagree_ram);
+#endif
+	// small enough to select by value, unlike a StandardRAM
+	uint8 agree_root[32];
+	uint8 disagree_root[32];
+	for (int i = 0; i < 32; i++) {
+		agree_root[i] = input.prover_bisection_root[agree_ram][i];
+		disagree_root[i] = input.prover_bisection_root[disagree_ram][i];
+	}
+	int ret = compareRoot(input.root, agree_root) == 1 && compareRoot(input.root_disagree, disagree_root) == 1;
+#ifdef RV64I_VERBOSE
+        if (ret == 0) {
+           printf("comparing agree/bisect roots failed\n");
+        }
+#endif
+        return ret && run_step_merkle(input) == 0 ? 0 : 1;
+}
+#endif
+
+#ifdef RV64I_PACKED_INPUT
+int rv64i_packed(const struct PackedInput input) {
+        return rv64i(unpackInput(input));
+}
+
+int mpc_main(struct PackedBisectInput input) {
+        return verify_bisection(unpackBisectInput(input));
+}
+#elif defined(RV64I_MERKLE)
+int mpc_main(struct MerkleBisectInput input) {
+        return verify_bisection_merkle(input);
+}
+#else
+int mpc_main(struct BisectInput input) {
+        return verify_bisection(input);
+}
+#endif
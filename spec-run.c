@@ -0,0 +1,280 @@
+// Runs a suite of circuit-sim spec files or test vectors against one Bristol circuit.
+//
+// The inputs of the cases are packed into bit-sliced lanes, 64 cases per
+// pass: wire i of the circuit is a 64-bit word whose bit k belongs to case k,
+// so one pass over the gates evaluates 64 cases with word-wide AND/XOR/OR/NOT.
+// The passes are shared out to a pool of threads, and so is the reading of
+// the files.
+//
+// A file is a text spec (spec.h) or a binary test vector file (testvec.h,
+// written by spec2vec or uarch-bisect -V), told apart by its magic. The fields
+// of a text spec go to the input bits in the order of input-layout.h: the
+// struct mpc_main takes when the circuit has as many inputs as it has bits,
+// the Input of rv64i when it has that many (bristol_circuit.txt). Build the
+// runner with the same -D flags as the circuit. With -w bits the fields go in
+// the order the spec lists them instead, every element that many bits wide
+// (the memory and digest bytes of keccak256-test-spec for keccak-bristol.js
+// --verify). A test vector file is mapped and its records feed the lanes in
+// place, 64 input bits per load; its field table has to match the build's
+// layout of the same name. The outputs, LSB first and sign extended, are the
+// return value.
+//
+// gcc -O2 -march=native -pthread -o spec-run spec-run.c
+// ./spec-run [-j threads] [-w bits] circuit.txt *.spec|*.vec
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "input-layout.h"
+#include "bristol.h"
+#include "spec.h"
+#include "testvec.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define LANES 64
+
+struct SpecFile {
+    const char *path;
+    struct SpecCase *cases;             // a text spec
+    struct TestVec vec;                 // a test vector file
+    size_t count;
+    char error[160];                    // the file as a whole
+};
+
+struct RunCase {
+    const char *file;                   // NULL when name says it all
+    const char *name;
+    const uint8 *bits;
+    int64 expected;
+    int64 got;
+    const char *error;                  // NULL when the case parsed
+};
+
+struct Runner {
+    const struct BristolCircuit *circuit;
+    struct SpecTarget target;           // neither layout nor width: text specs cannot be placed
+    struct SpecFile *files;
+    size_t file_count;
+    struct RunCase *cases;              // of all files, in order
+    struct RunCase **runnable;          // the ones without errors
+    size_t runnable_count;
+    atomic_size_t next;
+};
+
+static void read_file(const struct Runner *r, struct SpecFile *file) {
+    const struct BristolCircuit *c = r->circuit;
+    int ret = testvec_open(&file->vec, file->path);
+    if (ret < 0) {
+        snprintf(file->error, sizeof(file->error), "cannot read the test vectors");
+    } else if (ret == 0) {
+        const struct TestVecHeader *h = file->vec.header;
+        const struct InputLayout *l = NULL;
+        if (strncmp(h->layout, mpc_input_layout.name, sizeof(h->layout)) == 0) {
+            l = &mpc_input_layout;
+        } else if (strncmp(h->layout, step_input_layout.name, sizeof(h->layout)) == 0) {
+            l = &step_input_layout;
+        }
+        if ((uint64)h->input_bytes * 8 != c->inputs) {
+            snprintf(file->error, sizeof(file->error), "%u input bits, the circuit has %u", h->input_bytes * 8,
+                c->inputs);
+        } else if (l != NULL && !testvec_matches(&file->vec, l)) {
+            snprintf(file->error, sizeof(file->error), "the fields differ from %s in this build", l->name);
+        } else {
+            file->count = h->count;
+        }
+    } else if (r->target.layout == NULL && r->target.width == 0) {
+        snprintf(file->error, sizeof(file->error), "the circuit has %u inputs, mpc_main %zu and rv64i %zu in "
+            "this build; check the -D flags or use -w", c->inputs, layout_size(&mpc_input_layout) * 8,
+            layout_size(&step_input_layout) * 8);
+    } else {
+        file->cases = spec_parse_file(&r->target, file->path, &file->count);
+    }
+}
+
+static void *read_worker(void *arg) {
+    struct Runner *r = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&r->next, 1);
+        if (i >= r->file_count) {
+            return NULL;
+        }
+        read_file(r, &r->files[i]);
+    }
+}
+
+/// \brief Evaluates the cases first .. first + LANES - 1 in one pass
+static void run_group(const struct Runner *r, uint64 *w, size_t first) {
+    const struct BristolCircuit *c = r->circuit;
+    size_t lanes = r->runnable_count - first < LANES ? r->runnable_count - first : LANES;
+    memset(w, 0, (size_t)c->inputs * sizeof(uint64));
+    for (size_t k = 0; k < lanes; k++) {
+        // spec bits and test vector inputs are both padded to whole 64-bit words
+        bristol_set_lane(c, w, k, r->runnable[first + k]->bits);
+    }
+    bristol_eval_sliced(c, w);
+    for (size_t k = 0; k < lanes; k++) {
+        r->runnable[first + k]->got = bristol_lane_output(c, w, k);
+    }
+}
+
+static void *eval_worker(void *arg) {
+    struct Runner *r = arg;
+    uint64 *w = malloc((size_t)r->circuit->wires * sizeof(uint64));
+    for (;;) {
+        size_t group = atomic_fetch_add(&r->next, 1);
+        if (group * LANES >= r->runnable_count) {
+            free(w);
+            return NULL;
+        }
+        run_group(r, w, group * LANES);
+    }
+}
+
+/// \brief Runs worker on min(threads, jobs) threads; returns how many
+static int run_pool(struct Runner *r, size_t jobs, int threads, void *(*worker)(void *)) {
+    atomic_store(&r->next, 0);
+    if ((size_t)threads > jobs) {
+        threads = jobs > 0 ? (int)jobs : 1;
+    }
+    pthread_t *pool = malloc(sizeof(pthread_t) * threads);
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&pool[t], NULL, worker, r);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    free(pool);
+    return threads;
+}
+
+/// \brief Lists the cases of all files, those of a file with an error as one case
+static size_t collect_cases(struct Runner *r) {
+    size_t total = 0;
+    for (size_t i = 0; i < r->file_count; i++) {
+        total += r->files[i].error[0] != '\0' ? 1 : r->files[i].count;
+    }
+    r->cases = calloc(total, sizeof(struct RunCase));
+    r->runnable = malloc(total * sizeof(struct RunCase *));
+    struct RunCase *rc = r->cases;
+    for (size_t i = 0; i < r->file_count; i++) {
+        struct SpecFile *file = &r->files[i];
+        if (file->error[0] != '\0') {
+            rc->name = file->path;
+            rc->error = file->error;
+            rc++;
+            continue;
+        }
+        for (size_t j = 0; j < file->count; j++, rc++) {
+            if (file->cases != NULL) {
+                struct SpecCase *sc = &file->cases[j];
+                rc->name = sc->name;
+                rc->bits = sc->bits;
+                rc->expected = sc->expected;
+                rc->error = sc->error[0] != '\0' ? sc->error : NULL;
+            } else {
+                const struct TestVecRecord *rec = testvec_record(&file->vec, j);
+                rc->file = file->path;
+                rc->name = rec->name;
+                rc->bits = testvec_input(&file->vec, j);
+                rc->expected = rec->expected;
+            }
+            if (rc->error == NULL) {
+                r->runnable[r->runnable_count++] = rc;
+            }
+        }
+    }
+    return total;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j threads] [-w bits] circuit.txt spec|vectors...\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long width = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:w:")) != -1) {
+        switch (opt) {
+        case 'j': threads = atoi(optarg); break;
+        case 'w': width = strtol(optarg, NULL, 0); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind + 2 > argc || threads < 1 || width < 0 || width > 64) {
+        usage(argv[0]);
+    }
+    double t0 = now();
+    struct BristolCircuit c;
+    if (bristol_load(&c, argv[optind]) != 0) {
+        return 2;
+    }
+    if (c.outputs == 0) {
+        fprintf(stderr, "%s has no outputs\n", argv[optind]);
+        return 2;
+    }
+    struct Runner r = { .circuit = &c, .target = { .width = (uint32)width, .inputs = c.inputs } };
+    if (width == 0) {
+        if (layout_size(&mpc_input_layout) * 8 == c.inputs) {
+            r.target.layout = &mpc_input_layout;
+        } else if (layout_size(&step_input_layout) * 8 == c.inputs) {
+            r.target.layout = &step_input_layout;
+        }
+    }
+    double load_time = now() - t0;
+
+    t0 = now();
+    r.file_count = argc - optind - 1;
+    r.files = calloc(r.file_count, sizeof(struct SpecFile));
+    for (size_t i = 0; i < r.file_count; i++) {
+        r.files[i].path = argv[optind + 1 + i];
+    }
+    run_pool(&r, r.file_count, threads, read_worker);
+    size_t total = collect_cases(&r);
+    double read_time = now() - t0;
+
+    t0 = now();
+    size_t groups = (r.runnable_count + LANES - 1) / LANES;
+    int eval_threads = run_pool(&r, groups, threads, eval_worker);
+    double eval_time = now() - t0;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < total; i++) {
+        const struct RunCase *rc = &r.cases[i];
+        const char *sep = rc->file != NULL ? ":" : "";
+        const char *file = rc->file != NULL ? rc->file : "";
+        if (rc->error != NULL) {
+            printf("ERROR %s%s%s: %s\n", file, sep, rc->name, rc->error);
+        } else if (rc->got != rc->expected) {
+            printf("FAIL  %s%s%s: return_value %lld, expected %lld\n", file, sep, rc->name, (long long)rc->got,
+                (long long)rc->expected);
+            failed++;
+        } else {
+            printf("PASS  %s%s%s\n", file, sep, rc->name);
+        }
+    }
+    printf("%zu specs, %zu passed, %zu failed, %zu errors; %s %u gates, %zu passes of %d lanes; "
+        "load %.3f s, read %.3f s, evaluate %.3f s (%d threads)\n", total, r.runnable_count - failed, failed,
+        total - r.runnable_count, argv[optind], c.gates, groups, LANES, load_time, read_time, eval_time,
+        eval_threads);
+    for (size_t i = 0; i < r.file_count; i++) {
+        if (r.files[i].cases != NULL) {
+            spec_free(r.files[i].cases, r.files[i].count);
+        }
+        testvec_close(&r.files[i].vec);
+    }
+    free(r.runnable);
+    free(r.cases);
+    free(r.files);
+    bristol_free(&c);
+    return failed == 0 && total == r.runnable_count ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+// Parser for circuit-sim spec files.
+//
+// Include after input-layout.h. A spec file holds one or more cases,
+// "name := { field: value; ... };" followed by "return_value == N;",
+// separated by "---"; a value is a number (decimal, 0x hex, negative) or a
+// list of values, nested lists flattened. The fields of a case go to a bit
+// vector, every element LSB first: placed by the layout, or with a NULL layout
+// appended in the order the spec lists them, width bits per element.
+
+#ifndef SPEC_H
+#define SPEC_H
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SpecTarget {
+    const struct InputLayout *layout;   // NULL: spec order, width bits per element
+    uint32 width;
+    uint64 inputs;                      // bits of the vector
+};
+
+struct SpecCase {
+    char name[256];
+    uint8 *bits;            // the input bits, LSB first, padded to whole 64-bit words
+    int64 expected;
+    char error[160];        // empty when the case parsed
+};
+
+struct SpecParser {
+    const char *p;
+    const char *end;
+};
+
+static void spec_space(struct SpecParser *ps) {
+    while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\n' || *ps->p == '\r' || *ps->p == '\t')) {
+        ps->p++;
+    }
+}
+
+static bool spec_accept(struct SpecParser *ps, const char *token) {
+    size_t len = strlen(token);
+    spec_space(ps);
+    if ((size_t)(ps->end - ps->p) >= len && memcmp(ps->p, token, len) == 0) {
+        ps->p += len;
+        return true;
+    }
+    return false;
+}
+
+static size_t spec_identifier(struct SpecParser *ps, const char **start) {
+    spec_space(ps);
+    *start = ps->p;
+    while (ps->p < ps->end && (*ps->p == '_' || (*ps->p >= 'a' && *ps->p <= 'z') ||
+           (*ps->p >= 'A' && *ps->p <= 'Z') || (ps->p > *start && *ps->p >= '0' && *ps->p <= '9'))) {
+        ps->p++;
+    }
+    return ps->p - *start;
+}
+
+static bool spec_number(struct SpecParser *ps, int64 *value) {
+    spec_space(ps);
+    bool negative = ps->p < ps->end && *ps->p == '-';
+    ps->p += negative;
+    int base = 10;
+    if (ps->end - ps->p > 2 && ps->p[0] == '0' && (ps->p[1] == 'x' || ps->p[1] == 'X')) {
+        base = 16;
+        ps->p += 2;
+    }
+    uint64 v = 0;
+    const char *start = ps->p;
+    for (; ps->p < ps->end; ps->p++) {
+        char c = *ps->p;
+        int digit = c >= '0' && c <= '9' ? c - '0' : base == 16 && c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+            base == 16 && c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (digit < 0) {
+            break;
+        }
+        v = v * base + digit;
+    }
+    *value = negative ? -(int64)v : (int64)v;
+    return ps->p > start;
+}
+
+/// \brief Stores the elements of a value (a spec_number or nested lists) at bit
+/// offset *bit, width bits each; returns the spec_number of elements or -1
+static int64 spec_value(struct SpecParser *ps, uint8 *bits, uint64 *bit, uint64 limit, uint32 width) {
+    if (!spec_accept(ps, "[")) {
+        int64 v;
+        if (!spec_number(ps, &v) || *bit + width > limit ||
+            (width < 64 && (v >= (int64)1 << width || v < -((int64)1 << (width - 1))))) {
+            return -1;
+        }
+        for (uint32 b = 0; b < width; b++, (*bit)++) {
+            if (((uint64)v >> b) & 1) {
+                bits[*bit / 8] |= 1 << (*bit % 8);
+            }
+        }
+        return 1;
+    }
+    int64 count = 0;
+    if (spec_accept(ps, "]")) {
+        return 0;
+    }
+    do {
+        int64 n = spec_value(ps, bits, bit, limit, width);
+        if (n < 0) {
+            return -1;
+        }
+        count += n;
+    } while (spec_accept(ps, ","));
+    return spec_accept(ps, "]") ? count : -1;
+}
+
+/// \brief Parses the fields and the return value of the case at ps->p
+static bool spec_case(const struct SpecTarget *t, struct SpecParser *ps, struct SpecCase *sc) {
+    const struct InputLayout *l = t->layout;
+    uint64 inputs = t->inputs;
+    uint64 appended = 0;
+    uint32 assigned = 0;
+    sc->bits = calloc(inputs / 64 + 1, 8);
+    for (;;) {
+        const char *name;
+        size_t len = spec_identifier(ps, &name);
+        if (len == 12 && memcmp(name, "return_value", 12) == 0) {
+            break;
+        }
+        if (len == 0 || !spec_accept(ps, ":=") || !spec_accept(ps, "{")) {
+            snprintf(sc->error, sizeof(sc->error), "expected name := { or return_value");
+            return false;
+        }
+        while (!spec_accept(ps, "}")) {
+            len = spec_identifier(ps, &name);
+            if (len == 0 || !spec_accept(ps, ":")) {
+                snprintf(sc->error, sizeof(sc->error), "expected a field name");
+                return false;
+            }
+            uint64 bit = appended, limit = inputs;
+            uint32 width = t->width, f = 0;
+            if (l != NULL) {
+                bit = 0;
+                for (; f < l->field_count; f++) {
+                    const struct LayoutField *field = &l->fields[f];
+                    if (strlen(field->name) == len && memcmp(field->name, name, len) == 0) {
+                        break;
+                    }
+                    bit += (uint64)field->elem_bytes * 8 * field->count;
+                }
+                if (f == l->field_count) {
+                    snprintf(sc->error, sizeof(sc->error), "%.*s is not a field of %s", (int)len, name, l->name);
+                    return false;
+                }
+                width = l->fields[f].elem_bytes * 8;
+                limit = bit + (uint64)width * l->fields[f].count;
+            }
+            int64 count = spec_value(ps, sc->bits, &bit, limit, width);
+            if (count < 0 || (l != NULL && (uint64)count != l->fields[f].count) || !spec_accept(ps, ";")) {
+                snprintf(sc->error, sizeof(sc->error), "bad value of %.*s (%u-bit elements%s)", (int)len, name,
+                    width, count >= 0 ? ", wrong count" : "");
+                return false;
+            }
+            if (l != NULL) {
+                assigned++;
+            } else {
+                appended = bit;
+            }
+        }
+        spec_accept(ps, ";");
+    }
+    if (!spec_accept(ps, "==") || !spec_number(ps, &sc->expected) || !spec_accept(ps, ";")) {
+        snprintf(sc->error, sizeof(sc->error), "expected return_value == N;");
+        return false;
+    }
+    if (l != NULL && assigned != l->field_count) {
+        snprintf(sc->error, sizeof(sc->error), "%u of the %u fields of %s given", assigned, l->field_count, l->name);
+        return false;
+    }
+    if (l == NULL && appended != inputs) {
+        snprintf(sc->error, sizeof(sc->error), "%llu of the %llu input bits given", (unsigned long long)appended,
+            (unsigned long long)inputs);
+        return false;
+    }
+    return true;
+}
+
+/// \brief Parses the cases of the spec file at path into *count cases (at least one);
+/// a case that does not parse has its error set and ends the file
+static inline struct SpecCase *spec_parse_file(const struct SpecTarget *t, const char *path, size_t *count) {
+    size_t cap = 1;
+    *count = 0;
+    struct SpecCase *cases = calloc(cap, sizeof(struct SpecCase));
+    FILE *f = fopen(path, "rb");
+    char *data = NULL;
+    size_t size = 0;
+    if (f != NULL) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        data = malloc(size + 1);
+        size = fread(data, 1, size, f);
+        fclose(f);
+    }
+    if (data == NULL) {
+        snprintf(cases[0].name, sizeof(cases[0].name), "%s", path);
+        snprintf(cases[0].error, sizeof(cases[0].error), "%s", strerror(errno));
+        *count = 1;
+        return cases;
+    }
+    struct SpecParser ps = { data, data + size };
+    for (;;) {
+        while (spec_accept(&ps, "---")) {
+        }
+        spec_space(&ps);
+        if (ps.p == ps.end) {
+            break;
+        }
+        if (*count == cap) {
+            cap *= 2;
+            cases = realloc(cases, cap * sizeof(struct SpecCase));
+        }
+        struct SpecCase *sc = &cases[(*count)++];
+        memset(sc, 0, sizeof(*sc));
+        snprintf(sc->name, sizeof(sc->name), "%s#%zu", path, *count);
+        if (!spec_case(t, &ps, sc)) {
+            break;
+        }
+    }
+    if (*count == 0) {
+        *count = 1;
+        snprintf(cases[0].error, sizeof(cases[0].error), "no cases");
+    }
+    if (*count == 1) {
+        snprintf(cases[0].name, sizeof(cases[0].name), "%s", path);
+    }
+    free(data);
+    return cases;
+}
+
+static inline void spec_free(struct SpecCase *cases, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(cases[i].bits);
+    }
+    free(cases);
+}
+
+#endif
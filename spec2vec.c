@@ -0,0 +1,159 @@
+// Converts text specs and step logs to binary test vectors (testvec.h).
+//
+// Text specs are placed by the layout of input-layout.h, mpc_main by default
+// or rv64i with -l rv64i, and keep their return_value; the record is named
+// after the file (and #case when the file holds several). With -s the inputs
+// are step logs instead: every step becomes an rv64i record, the access log
+// as rv64i takes it (steplog_input) and the return_value of rv64i computed
+// natively, named file@cycle. Build with the same -D flags as the circuit;
+// spec-run refuses vectors whose field table differs from its own build.
+//
+// gcc -O2 -o spec2vec spec2vec.c
+// ./spec2vec [-l mpc_main|rv64i] -o suite.vec *.spec
+// ./spec2vec -s -o steps.vec rv64ui-uarch-*-steps.json
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "steplog.h"
+#include "input-layout.h"
+#include "spec.h"
+#include "testvec.h"
+
+#include <libgen.h>
+
+/// \brief The record name: the file name without its directory, suffixed
+static void record_name(char *name, size_t size, const char *path, const char *suffix) {
+    char *copy = strdup(path);
+    snprintf(name, size, "%s%s", basename(copy), suffix);
+    free(copy);
+}
+
+static int convert_spec(struct TestVecWriter *w, const struct InputLayout *l, const char *path) {
+    struct SpecTarget target = { l, 0, layout_size(l) * 8 };
+    size_t count;
+    struct SpecCase *cases = spec_parse_file(&target, path, &count);
+    for (size_t i = 0; i < count; i++) {
+        if (cases[i].error[0] != '\0') {
+            fprintf(stderr, "%s: %s, file skipped\n", cases[i].name, cases[i].error);
+            spec_free(cases, count);
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        char suffix[24] = "", name[sizeof(((struct TestVecRecord *)0)->name)];
+        if (count > 1) {
+            snprintf(suffix, sizeof(suffix), "#%zu", i + 1);
+        }
+        record_name(name, sizeof(name), path, suffix);
+        testvec_add(w, name, cases[i].expected, cases[i].bits);
+    }
+    spec_free(cases, count);
+    return 0;
+}
+
+static int convert_steps(struct TestVecWriter *w, const char *path, uint8 *packed) {
+    struct StepLog log;
+    if (steplog_open(&log, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    const char *end = log.data + log.size;
+    struct StepRecord *rec = malloc(sizeof(struct StepRecord));
+    uint64 steps = 0, skipped = 0;
+    int ret = 0;
+    for (const char *p = steplog_find_step(log.data, end, log.data); p != NULL;
+         p = steplog_find_step(p, end, log.data)) {
+        uint64 cycle = 0;
+        steplog_step_cycle(p, end, &cycle);
+        p = steplog_parse_step(p, end, rec);
+        if (p == NULL) {
+            fprintf(stderr, "%s: parse error after %llu steps\n", path, (unsigned long long)steps);
+            ret = -1;
+            break;
+        }
+        struct Input input;
+        if (!steplog_input(rec, &input)) {
+            skipped++;
+            continue;
+        }
+#if defined(RV64I_PACKED_INPUT)
+        StepInput step;
+        if (!packInput(&input, &step)) {
+            skipped++;
+            continue;
+        }
+        int expected = rv64i_packed(step);
+#else
+        StepInput step = input;
+        int expected = rv64i(step);
+#endif
+        char suffix[24], name[sizeof(((struct TestVecRecord *)0)->name)];
+        snprintf(suffix, sizeof(suffix), "@%llu", (unsigned long long)cycle);
+        record_name(name, sizeof(name), path, suffix);
+        layout_pack(&step_input_layout, &step, packed);
+        testvec_add(w, name, expected, packed);
+        steps++;
+    }
+    if (skipped > 0) {
+        fprintf(stderr, "%s: skipped %llu steps that do not fit the access log or the packed slots\n", path,
+            (unsigned long long)skipped);
+    }
+    free(rec);
+    steplog_close(&log);
+    return ret;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-l mpc_main|rv64i] -o vectors spec...\n"
+        "       %s -s -o vectors steps.json...\n", name, name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    const struct InputLayout *l = &mpc_input_layout;
+    bool steps = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:o:s")) != -1) {
+        switch (opt) {
+        case 'l':
+            if (strcmp(optarg, mpc_input_layout.name) == 0) {
+                l = &mpc_input_layout;
+            } else if (strcmp(optarg, step_input_layout.name) == 0) {
+                l = &step_input_layout;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'o': output = optarg; break;
+        case 's': steps = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (output == NULL || optind == argc) {
+        usage(argv[0]);
+    }
+    if (steps) {
+        l = &step_input_layout;
+    }
+    struct TestVecWriter w;
+    if (testvec_create(&w, output, l) != 0) {
+        return 2;
+    }
+    uint8 *packed = malloc(layout_size(l));
+    // a file that does not convert is left out, the others are still written
+    int skipped = 0;
+    for (int i = optind; i < argc; i++) {
+        skipped += (steps ? convert_steps(&w, argv[i], packed) : convert_spec(&w, l, argv[i])) != 0;
+    }
+    free(packed);
+    uint64 count = w.header.count;
+    if (testvec_finish(&w) != 0) {
+        remove(output);
+        return 2;
+    }
+    fprintf(stderr, "wrote %llu %s vectors of %u bytes to %s", (unsigned long long)count, l->name,
+        w.header.input_bytes, output);
+    fprintf(stderr, skipped > 0 ? ", %d files skipped\n" : "\n", skipped);
+    return skipped > 0 ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// Throughput of the step log parser (steplog.h): the hex decoding of
+// circuit_ram alone, scalar and vectorized, and whole steps, single-threaded.
+// The vectorized decoder is checked against the scalar one first, on random
+// digits of both cases and with a non-hex digit at every position.
+//
+// gcc -O2 -march=native -o steplog-bench steplog-bench.c   (AVX2)
+// gcc -O2 -o steplog-bench steplog-bench.c                 (SSE2)
+// ./steplog-bench [-t seconds] rv64ui-uarch-simple-steps.json
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "steplog.h"
+
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void check_unhex(void) {
+    static char hex[RAM_SIZE * 2];
+    static uint8 a[RAM_SIZE], b[RAM_SIZE];
+    static const char digits[] = "0123456789abcdefABCDEF";
+    srand(1);
+    for (size_t i = 0; i < sizeof(hex); i++) {
+        hex[i] = digits[rand() % 22];
+    }
+    for (size_t n = 0; n <= 100; n++) {
+        size_t off = rand() % 64;
+        if (!steplog_unhex(hex + off, a, n) || !steplog_unhex_scalar(hex + off, b, n) || memcmp(a, b, n) != 0) {
+            fprintf(stderr, "steplog_unhex differs from steplog_unhex_scalar on %zu bytes\n", n);
+            exit(1);
+        }
+    }
+    static const char bad[] = "/:@G`g \"\x80\xff";
+    for (size_t i = 0; i < 128; i++) {
+        for (const char *c = bad; *c != '\0'; c++) {
+            char saved = hex[i];
+            hex[i] = *c;
+            if (steplog_unhex(hex, a, 64)) {
+                fprintf(stderr, "steplog_unhex accepts 0x%02x at %zu\n", (uint8)*c, i);
+                exit(1);
+            }
+            hex[i] = saved;
+        }
+    }
+}
+
+static double decode_rate(bool (*unhex)(const char *, uint8 *, size_t), const char *hex, uint8 *out,
+    double seconds) {
+    uint64 bytes = 0;
+    double t0 = now(), t;
+    do {
+        for (int r = 0; r < 256; r++) {
+            unhex(hex, out, RAM_SIZE);
+            bytes += RAM_SIZE * 2;
+        }
+        t = now() - t0;
+    } while (t < seconds);
+    return bytes / t;
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 1.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        if (opt == 't') {
+            seconds = atof(optarg);
+        } else {
+            optind = argc;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-t seconds] steps.json\n", argv[0]);
+        return 2;
+    }
+    check_unhex();
+    struct StepLog log;
+    if (steplog_open(&log, argv[optind]) != 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+    const char *end = log.data + log.size;
+    const char *first = steplog_find_step(log.data, end, log.data);
+    const char *p = first, *key, *hex;
+    size_t keylen, len;
+    if (first == NULL || steplog_member(&p, end, true, &key, &keylen) != 1 ||
+        !STEPLOG_KEY_IS(key, keylen, "circuit_ram") || steplog_string(p, end, &hex, &len) == NULL ||
+        len != RAM_SIZE * 2) {
+        fprintf(stderr, "%s: no step with a circuit_ram\n", argv[optind]);
+        return 2;
+    }
+#if defined(__AVX2__)
+    const char *isa = "AVX2";
+#elif defined(__SSE2__)
+    const char *isa = "SSE2";
+#else
+    const char *isa = "scalar";
+#endif
+    uint8 *ram = malloc(RAM_SIZE);
+    double scalar = decode_rate(steplog_unhex_scalar, hex, ram, seconds);
+    double vector = decode_rate(steplog_unhex, hex, ram, seconds);
+    printf("circuit_ram hex: scalar %.2f GB/s, %s %.2f GB/s (%.1fx)\n", scalar / 1e9, isa, vector / 1e9,
+        vector / scalar);
+
+    struct StepRecord *rec = malloc(sizeof(struct StepRecord));
+    uint64 steps = 0, bytes = 0;
+    double t0 = now(), t;
+    do {
+        for (p = first; p != NULL; p = steplog_find_step(p, end, log.data)) {
+            const char *q = steplog_parse_step(p, end, rec);
+            if (q == NULL) {
+                fprintf(stderr, "%s: parse error after %llu steps\n", argv[optind], (unsigned long long)steps);
+                return 1;
+            }
+            bytes += q - p;
+            steps++;
+            p = q;
+        }
+        t = now() - t0;
+    } while (t < seconds);
+    printf("steps: %.0f steps/s, %.2f GB/s of step objects (%s)\n", steps / t, bytes / t / 1e9, isa);
+    free(rec);
+    free(ram);
+    steplog_close(&log);
+    return 0;
+}
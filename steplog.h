@@ -0,0 +1,486 @@
+// Reader for rv64ui-uarch-*-steps.json step logs.
+//
+// Include after rv64i.c (uses its integer types and RAM geometry). The log
+// is memory mapped and parsed in place, without building a DOM, so it works
+// on logs far larger than memory. Steps are found by their "circuit_ram" key,
+// which the emulator writes first in every step object; that lets a log be
+// split into independent chunks that are parsed in parallel. The hex of
+// circuit_ram is decoded and skipped values are scanned with SSE2, or AVX2
+// when built with -march for it (steplog-bench measures both).
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define STEPLOG_MAX_ACCESSES 16
+
+#define STEPLOG_READ 0
+#define STEPLOG_WRITE 1
+
+struct StepRecord {
+    uint64 ram[RAM_SIZE / 8];   // circuit_ram before the step
+    uint32 access_count;
+    uint64 access_paddr[STEPLOG_MAX_ACCESSES];
+    uint64 access_val[STEPLOG_MAX_ACCESSES];
+    uint8 access_type[STEPLOG_MAX_ACCESSES];
+};
+
+struct StepLog {
+    const char *data;
+    size_t size;
+};
+
+static int steplog_open(struct StepLog *log, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    log->size = st.st_size;
+    log->data = "";
+    if (log->size > 0) {
+        void *p = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(p, log->size, MADV_SEQUENTIAL);
+        log->data = p;
+    }
+    close(fd);
+    return 0;
+}
+
+static void steplog_close(struct StepLog *log) {
+    if (log->size > 0) {
+        munmap((void *)log->data, log->size);
+    }
+    log->data = NULL;
+    log->size = 0;
+}
+
+static const char STEPLOG_KEY[] = "\"circuit_ram\"";
+
+/// \brief Returns the start ('{') of the step whose key is at k, or NULL if k is not a step key
+static const char *steplog_step_at(const char *k, const char *end, const char *data) {
+    size_t keylen = sizeof(STEPLOG_KEY) - 1;
+    if ((size_t)(end - k) < keylen || memcmp(k, STEPLOG_KEY, keylen) != 0) {
+        return NULL;
+    }
+    const char *b = k;
+    while (b > data && (b[-1] == ' ' || b[-1] == '\n' || b[-1] == '\r' || b[-1] == '\t')) {
+        b--;
+    }
+    return b > data && b[-1] == '{' ? b - 1 : NULL;
+}
+
+/// \brief Returns the start ('{') of the first step whose key lies in [p, end), or NULL
+static const char *steplog_find_step(const char *p, const char *end, const char *data) {
+    while (p < end) {
+        const char *k = memchr(p, '"', end - p);
+        if (k == NULL) {
+            return NULL;
+        }
+        const char *s = steplog_step_at(k, end, data);
+        if (s != NULL) {
+            return s;
+        }
+        p = k + 1;
+    }
+    return NULL;
+}
+
+/// \brief Returns the start of the last step of the log, or NULL
+static inline const char *steplog_last_step(const struct StepLog *log) {
+    const char *end = log->data + log->size;
+    const char *p = end;
+    while (p > log->data) {
+        p--;
+        if (*p == '"') {
+            const char *s = steplog_step_at(p, end, log->data);
+            if (s != NULL) {
+                return s;
+            }
+        }
+    }
+    return NULL;
+}
+
+static inline const char *steplog_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+static const signed char steplog_hexval[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/// \brief Decodes 2 * n hex digits into n bytes, returns false on a non-hex digit
+static inline bool steplog_unhex_scalar(const char *hex, uint8 *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int hi = steplog_hexval[(uint8)hex[2 * i]] - 1;
+        int lo = steplog_hexval[(uint8)hex[2 * i + 1]] - 1;
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i] = (uint8)(hi << 4 | lo);
+    }
+    return true;
+}
+
+#if defined(__AVX2__)
+/// \brief The nibbles of 32 hex digits, and in *valid a mask of the digits that are hex
+static inline __m256i steplog_nibbles256(__m256i c, uint32 *valid) {
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+    *valid = (uint32)_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha));
+    return _mm256_blendv_epi8(_mm256_add_epi8(alpha, _mm256_set1_epi8(10)), digit, is_digit);
+}
+#endif
+
+#if defined(__SSE2__)
+static inline __m128i steplog_nibbles128(__m128i c, uint32 *valid) {
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+    *valid = (uint32)_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha));
+    __m128i nib = _mm_or_si128(_mm_and_si128(is_digit, digit),
+        _mm_andnot_si128(is_digit, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+    // the first digit of a pair is the low byte of its 16-bit word and the high nibble
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(nib, 4), _mm_set1_epi16(0xf0)), _mm_srli_epi16(nib, 8));
+}
+#endif
+
+/// \brief steplog_unhex_scalar, 32 bytes per step with AVX2 and 16 with SSE2: the
+/// digits are classified and converted in vector registers and the pairs
+/// joined by a multiply-add (AVX2) or shifts (SSE2), then packed
+static bool steplog_unhex(const char *hex, uint8 *out, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i pair = _mm256_set1_epi16(0x0110);
+    for (; i + 32 <= n; i += 32) {
+        uint32 va, vb;
+        __m256i a = steplog_nibbles256(_mm256_loadu_si256((const __m256i *)(hex + 2 * i)), &va);
+        __m256i b = steplog_nibbles256(_mm256_loadu_si256((const __m256i *)(hex + 2 * i + 32)), &vb);
+        if ((va & vb) != 0xffffffff) {
+            return false;
+        }
+        // 16-bit hi * 16 + lo, packed to bytes; packus works per 128-bit lane
+        __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(a, pair), _mm256_maddubs_epi16(b, pair));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute4x64_epi64(bytes, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        uint32 va, vb;
+        __m128i a = steplog_nibbles128(_mm_loadu_si128((const __m128i *)(hex + 2 * i)), &va);
+        __m128i b = steplog_nibbles128(_mm_loadu_si128((const __m128i *)(hex + 2 * i + 16)), &vb);
+        if ((va & vb) != 0xffff) {
+            return false;
+        }
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    return steplog_unhex_scalar(hex + 2 * i, out + i, n - i);
+}
+
+/// \brief Parses a string token, sets [*s, *s + *len) to its contents (no escapes in step logs)
+static const char *steplog_string(const char *p, const char *end, const char **s, size_t *len) {
+    if (p >= end || *p != '"') {
+        return NULL;
+    }
+    const char *q = memchr(p + 1, '"', end - p - 1);
+    if (q == NULL) {
+        return NULL;
+    }
+    *s = p + 1;
+    *len = q - p - 1;
+    return q + 1;
+}
+
+static const char *steplog_uint(const char *p, const char *end, uint64 *v) {
+    if (p >= end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+    uint64 x = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        x = x * 10 + (*p++ - '0');
+    }
+    *v = x;
+    return p;
+}
+
+/// \brief Returns the first '"', '{', '}', '[' or ']' in [p, end), or end. The
+/// proofs of the accesses are mostly indentation and hashes, so values are
+/// skipped a vector at a time; '[' and ']' are '{' and '}' without bit 5
+static inline const char *steplog_structural(const char *p, const char *end) {
+#if defined(__AVX2__)
+    for (; end - p >= 32; p += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)p);
+        __m256i b = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(b, _mm256_set1_epi8('}'))));
+        uint32 mask = (uint32)_mm256_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; end - p >= 16; p += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)p);
+        __m128i b = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')),
+            _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('{')), _mm_cmpeq_epi8(b, _mm_set1_epi8('}'))));
+        uint32 mask = (uint32)_mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while (p < end && *p != '"' && (*p | 0x20) != '{' && (*p | 0x20) != '}') {
+        p++;
+    }
+    return p;
+}
+
+/// \brief Skips any JSON value
+static const char *steplog_skip(const char *p, const char *end) {
+    p = steplog_ws(p, end);
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        const char *s;
+        size_t len;
+        return steplog_string(p, end, &s, &len);
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while ((p = steplog_structural(p, end)) < end) {
+            char c = *p++;
+            if (c == '"') {
+                p = memchr(p, '"', end - p);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p++;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (--depth == 0) {
+                return p;
+            }
+        }
+        return NULL;
+    }
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+/// \brief Iterates the members of an object: call with *p at '{' or after a member value;
+/// returns 1 with the key set, 0 after the closing '}', -1 on error
+static int steplog_member(const char **p, const char *end, bool first, const char **key, size_t *keylen) {
+    const char *q = steplog_ws(*p, end);
+    if (first) {
+        if (q >= end || *q != '{') {
+            return -1;
+        }
+        q = steplog_ws(q + 1, end);
+    } else if (q < end && *q == ',') {
+        q = steplog_ws(q + 1, end);
+    }
+    if (q < end && *q == '}') {
+        *p = q + 1;
+        return 0;
+    }
+    q = steplog_string(q, end, key, keylen);
+    if (q == NULL) {
+        return -1;
+    }
+    q = steplog_ws(q, end);
+    if (q >= end || *q != ':') {
+        return -1;
+    }
+    *p = steplog_ws(q + 1, end);
+    return 1;
+}
+
+#define STEPLOG_KEY_IS(key, len, lit) ((len) == sizeof(lit) - 1 && memcmp((key), (lit), (len)) == 0)
+
+static const char *steplog_access(const char *p, const char *end, struct StepRecord *rec) {
+    if (rec->access_count >= STEPLOG_MAX_ACCESSES) {
+        return NULL;
+    }
+    uint32 n = rec->access_count++;
+    const char *key;
+    size_t keylen;
+    int r;
+    bool first = true;
+    rec->access_type[n] = STEPLOG_READ;
+    rec->access_paddr[n] = 0;
+    rec->access_val[n] = 0;
+    while ((r = steplog_member(&p, end, first, &key, &keylen)) > 0) {
+        first = false;
+        if (STEPLOG_KEY_IS(key, keylen, "type")) {
+            const char *s;
+            size_t len;
+            p = steplog_string(p, end, &s, &len);
+            if (p == NULL) {
+                return NULL;
+            }
+            rec->access_type[n] = STEPLOG_KEY_IS(s, len, "write") ? STEPLOG_WRITE : STEPLOG_READ;
+        } else if (STEPLOG_KEY_IS(key, keylen, "address")) {
+            p = steplog_uint(p, end, &rec->access_paddr[n]);
+        } else if (STEPLOG_KEY_IS(key, keylen, "value")) {
+            const char *s;
+            size_t len;
+            uint8 bytes[8];
+            p = steplog_string(p, end, &s, &len);
+            if (p == NULL || len != 16 || !steplog_unhex(s, bytes, 8)) {
+                return NULL;
+            }
+            memcpy(&rec->access_val[n], bytes, 8);
+        } else {
+            p = steplog_skip(p, end);
+        }
+        if (p == NULL) {
+            return NULL;
+        }
+    }
+    return r == 0 ? p : NULL;
+}
+
+/// \brief Parses the step object starting at p, returns the position after it or NULL on error
+static const char *steplog_parse_step(const char *p, const char *end, struct StepRecord *rec) {
+    const char *key;
+    size_t keylen;
+    int r;
+    bool first = true;
+    bool have_ram = false;
+    rec->access_count = 0;
+    while ((r = steplog_member(&p, end, first, &key, &keylen)) > 0) {
+        first = false;
+        if (STEPLOG_KEY_IS(key, keylen, "circuit_ram")) {
+            const char *s;
+            size_t len;
+            p = steplog_string(p, end, &s, &len);
+            if (p == NULL || len != RAM_SIZE * 2 || !steplog_unhex(s, (uint8 *)rec->ram, RAM_SIZE)) {
+                return NULL;
+            }
+            have_ram = true;
+        } else if (STEPLOG_KEY_IS(key, keylen, "accesses")) {
+            p = steplog_ws(p, end);
+            if (p >= end || *p != '[') {
+                return NULL;
+            }
+            p = steplog_ws(p + 1, end);
+            while (p != NULL && p < end && *p != ']') {
+                p = steplog_access(p, end, rec);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p = steplog_ws(p, end);
+                if (p < end && *p == ',') {
+                    p = steplog_ws(p + 1, end);
+                }
+            }
+            if (p == NULL || p >= end) {
+                return NULL;
+            }
+            p++;
+        } else {
+            p = steplog_skip(p, end);
+        }
+        if (p == NULL) {
+            return NULL;
+        }
+    }
+    return r == 0 && have_ram ? p : NULL;
+}
+
+/// \brief Reads the cycle counter (UCYCLE) from the circuit_ram of the step at p,
+/// which is its first member; returns false if it is not there
+static inline bool steplog_step_cycle(const char *p, const char *end, uint64 *cycle) {
+    const char *key;
+    size_t keylen;
+    const char *s;
+    size_t len;
+    uint8 bytes[8];
+    if (steplog_member(&p, end, true, &key, &keylen) != 1 || !STEPLOG_KEY_IS(key, keylen, "circuit_ram") ||
+        steplog_string(p, end, &s, &len) == NULL || len != RAM_SIZE * 2 ||
+        !steplog_unhex(s + ramOffset(UCYCLE) * 2, bytes, 8)) {
+        return false;
+    }
+    memcpy(cycle, bytes, 8);
+    return true;
+}
+
+/// \brief Returns the step whose cycle counter is cycle, or NULL. The cycles of a
+/// log increase with its steps, so the step is found by bisecting the file on byte
+/// offsets, in O(log size) probes instead of a scan.
+static inline const char *steplog_seek(const struct StepLog *log, uint64 cycle) {
+    const char *end = log->data + log->size;
+    size_t lo = 0;
+    size_t hi = log->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *s = steplog_find_step(log->data + mid, end, log->data);
+        uint64 c;
+        if (s == NULL || !steplog_step_cycle(s, end, &c) || c > cycle) {
+            // the step wanted, if any, has its key before mid
+            hi = mid;
+        } else if (c == cycle) {
+            return s;
+        } else {
+            // continue after this step's key, which lies at or after mid
+            lo = (const char *)memchr(s, '"', end - s) - log->data + 1;
+        }
+    }
+    return NULL;
+}
+
+/// \brief Maps an access address to its StandardRAM word, the same way ramPlusState does;
+/// returns false if it falls outside the page
+static inline bool steplog_word(uint64 paddr, uint32 *word) {
+    uint64 off = ramOffset(paddr) / 8;
+    if (off >= RAM_SIZE / 8) {
+        return false;
+    }
+    *word = (uint32)off;
+    return true;
+}
+
+/// \brief The access log of the step in rec as the Input of rv64i; returns false if
+/// it does not fit ACCESS_LOG_SIZE
+static inline bool steplog_input(const struct StepRecord *rec, struct Input *in) {
+    if (rec->access_count + 1 > ACCESS_LOG_SIZE) {
+        return false;
+    }
+    memset(in, 0, sizeof(*in));
+    for (uint32 i = 0; i < rec->access_count; i++) {
+        in->access_paddr[i] = rec->access_paddr[i];
+        in->access_val[i] = rec->access_val[i];
+        in->access_readWriteEnd[i] = rec->access_type[i];
+    }
+    in->access_readWriteEnd[rec->access_count] = 2;
+    return true;
+}
@@ -0,0 +1,284 @@
+// Indexed step store: a step log in binary, with the RAM delta-compressed.
+//
+// Include after steplog.h. A step writes a few words of its 8 KB circuit_ram,
+// so the store keeps the full RAM only every keyframe_interval steps (and
+// wherever a step's circuit_ram is not the previous one plus its writes) and
+// otherwise just the access log of every step, which holds the writes. An
+// index by step gives the cycle, the record and the keyframe of every step:
+// the RAM before any step is rebuilt from its keyframe plus at most
+// keyframe_interval - 1 access logs, and a cycle is found by bisecting the
+// index. The file is memory mapped; bisection touches only the pages of the
+// steps it asks for. Little endian:
+//
+//   struct StepStoreHeader
+//   records, in step order, 8-byte aligned:
+//     StandardRAM (keyframes only, 64-byte aligned), the RAM before the step
+//     struct StepStoreStep, then access_count struct StepStoreAccess
+//   the RAM after the last step
+//   struct StepStoreIndex[steps]
+//
+// The RAM geometry (RAM_WORD_BITS, RAM_WINDOWS) is the writer's; use a build
+// with the same -D flags to read it.
+
+#ifndef STEPSTORE_H
+#define STEPSTORE_H
+
+#define STEPSTORE_MAGIC "RVSTEPS1"
+#define STEPSTORE_NO_WORD 0xffffffffu
+
+struct StepStoreHeader {
+    char magic[8];
+    uint32 ram_bytes;           // RAM_SIZE of the writer
+    uint32 keyframe_interval;
+    uint64 steps;
+    uint64 final_offset;        // the RAM after the last step
+    uint64 index_offset;
+    uint64 keyframes;
+};
+
+struct StepStoreStep {
+    uint32 access_count;
+    uint32 keyframe;            // 1 if the RAM before this step precedes the record
+};
+
+struct StepStoreAccess {
+    uint64 paddr;
+    uint64 val;
+    uint32 type;                // STEPLOG_READ or STEPLOG_WRITE
+    uint32 word;                // StandardRAM word, or STEPSTORE_NO_WORD outside it
+};
+
+struct StepStoreIndex {
+    uint64 cycle;
+    uint64 offset;              // of the StepStoreStep
+    uint64 keyframe;            // step index of the latest keyframe at or before this step
+};
+
+struct StepStoreWriter {
+    FILE *f;
+    const char *path;
+    struct StepStoreHeader header;
+    struct StepStoreIndex *index;
+    uint64 cap;
+    uint64 ram[RAM_SIZE / 8];   // the RAM after the last step added
+};
+
+/// \brief Creates path; returns 0, or -1 with a message on stderr
+static inline int stepstore_create(struct StepStoreWriter *w, const char *path, uint32 keyframe_interval) {
+    memset(w, 0, sizeof(*w));
+    w->path = path;
+    w->f = fopen(path, "wb");
+    if (w->f == NULL) {
+        perror(path);
+        return -1;
+    }
+    memcpy(w->header.magic, STEPSTORE_MAGIC, sizeof(w->header.magic));
+    w->header.ram_bytes = RAM_SIZE;
+    w->header.keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    fwrite(&w->header, sizeof(w->header), 1, w->f);
+    return 0;
+}
+
+static inline void stepstore_pad(FILE *f, uint64 align) {
+    static const uint8 zero[64];
+    long pos = ftell(f);
+    fwrite(zero, 1, (align - pos % align) % align, f);
+}
+
+/// \brief Applies the writes of a record to ram
+static inline void stepstore_apply(const struct StepStoreStep *step, uint64 *ram) {
+    const struct StepStoreAccess *a = (const struct StepStoreAccess *)(step + 1);
+    for (uint32 i = 0; i < step->access_count; i++) {
+        if (a[i].type == STEPLOG_WRITE && a[i].word != STEPSTORE_NO_WORD) {
+            ram[a[i].word] = a[i].val;
+        }
+    }
+}
+
+/// \brief Appends the step in rec, whose circuit_ram is the RAM before it
+static inline void stepstore_add(struct StepStoreWriter *w, uint64 cycle, const struct StepRecord *rec) {
+    struct StepStoreHeader *h = &w->header;
+    if (h->steps == w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 1024;
+        w->index = realloc(w->index, w->cap * sizeof(struct StepStoreIndex));
+    }
+    struct StepStoreIndex *ix = &w->index[h->steps];
+    struct StepStoreStep step = { rec->access_count, 0 };
+    step.keyframe = h->steps % h->keyframe_interval == 0 || memcmp(w->ram, rec->ram, RAM_SIZE) != 0;
+    if (step.keyframe) {
+        stepstore_pad(w->f, 64);
+        fwrite(rec->ram, 1, RAM_SIZE, w->f);
+        h->keyframes++;
+    }
+    ix->cycle = cycle;
+    ix->offset = ftell(w->f);
+    ix->keyframe = step.keyframe ? h->steps : w->index[h->steps - 1].keyframe;
+    memcpy(w->ram, rec->ram, RAM_SIZE);
+    struct StepStoreAccess a[STEPLOG_MAX_ACCESSES];
+    memset(a, 0, sizeof(a));
+    for (uint32 i = 0; i < rec->access_count; i++) {
+        a[i].paddr = rec->access_paddr[i];
+        a[i].val = rec->access_val[i];
+        a[i].type = rec->access_type[i];
+        if (!steplog_word(a[i].paddr, &a[i].word)) {
+            a[i].word = STEPSTORE_NO_WORD;
+        }
+        if (a[i].type == STEPLOG_WRITE && a[i].word != STEPSTORE_NO_WORD) {
+            w->ram[a[i].word] = a[i].val;
+        }
+    }
+    fwrite(&step, sizeof(step), 1, w->f);
+    fwrite(a, sizeof(a[0]), rec->access_count, w->f);
+    h->steps++;
+}
+
+/// \brief Writes the final RAM, the index and the header and closes the file; returns 0 or -1
+static inline int stepstore_finish(struct StepStoreWriter *w) {
+    struct StepStoreHeader *h = &w->header;
+    stepstore_pad(w->f, 64);
+    long final_offset = ftell(w->f);
+    fwrite(w->ram, 1, RAM_SIZE, w->f);
+    long index_offset = ftell(w->f);
+    fwrite(w->index, sizeof(struct StepStoreIndex), h->steps, w->f);
+    h->final_offset = final_offset;
+    h->index_offset = index_offset;
+    int ret = 0;
+    // the records are written unchecked, a failed one (a full disk) leaves the error flag set
+    if (final_offset < 0 || index_offset < 0 || ferror(w->f) ||
+        fseek(w->f, 0, SEEK_SET) != 0 || fwrite(h, sizeof(*h), 1, w->f) != 1) {
+        ret = -1;
+    }
+    if (fclose(w->f) != 0 || ret != 0) {
+        perror(w->path);
+        ret = -1;
+    }
+    free(w->index);
+    return ret;
+}
+
+struct StepStore {
+    const uint8 *data;
+    size_t size;
+    const struct StepStoreHeader *header;
+    const struct StepStoreIndex *index;
+};
+
+/// \brief Whether every step's record and keyframe lie between the header and
+/// the final RAM; reads the index only, not the records
+static inline bool stepstore_index_valid(const struct StepStore *s) {
+    const struct StepStoreHeader *h = s->header;
+    const struct StepStoreIndex *index = (const struct StepStoreIndex *)(s->data + h->index_offset);
+    if (h->index_offset % 8 != 0 || h->final_offset < sizeof(struct StepStoreHeader) + RAM_SIZE) {
+        return false;
+    }
+    for (uint64 i = 0; i < h->steps; i++) {
+        uint64 offset = index[i].offset;
+        uint64 k = index[i].keyframe;
+        if (offset % 8 != 0 || offset < sizeof(struct StepStoreHeader) ||
+            offset > h->final_offset - sizeof(struct StepStoreStep) ||
+            k > i || index[k].offset < sizeof(struct StepStoreHeader) + RAM_SIZE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief Maps the store at path; returns 0, 1 if it is not a store (no
+/// message), or -1 with a message on stderr
+static inline int stepstore_open(struct StepStore *s, const char *path) {
+    memset(s, 0, sizeof(*s));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    char magic[8];
+    if (st.st_size < (off_t)sizeof(struct StepStoreHeader) || pread(fd, magic, 8, 0) != 8 ||
+        memcmp(magic, STEPSTORE_MAGIC, 8) != 0) {
+        close(fd);
+        return 1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    s->data = data;
+    s->size = st.st_size;
+    s->header = data;
+    const struct StepStoreHeader *h = s->header;
+    if (h->ram_bytes != RAM_SIZE) {
+        fprintf(stderr, "%s: written with %u bytes of RAM, this build has %d\n", path, h->ram_bytes, RAM_SIZE);
+    } else if (h->steps == 0 || h->final_offset > s->size - RAM_SIZE || h->index_offset > s->size ||
+        (s->size - h->index_offset) / sizeof(struct StepStoreIndex) < h->steps) {
+        fprintf(stderr, "%s: inconsistent step store header\n", path);
+    } else if (!stepstore_index_valid(s)) {
+        fprintf(stderr, "%s: step store index points outside its records\n", path);
+    } else {
+        s->index = (const struct StepStoreIndex *)(s->data + h->index_offset);
+        madvise(data, st.st_size, MADV_RANDOM);
+        return 0;
+    }
+    munmap(data, st.st_size);
+    memset(s, 0, sizeof(*s));
+    return -1;
+}
+
+static inline void stepstore_close(struct StepStore *s) {
+    if (s->data != NULL) {
+        munmap((void *)s->data, s->size);
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+/// \brief The step whose cycle counter is cycle, or -1
+static inline int64 stepstore_find(const struct StepStore *s, uint64 cycle) {
+    uint64 lo = 0, hi = s->header->steps;
+    while (lo < hi) {
+        uint64 mid = lo + (hi - lo) / 2;
+        if (s->index[mid].cycle < cycle) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < s->header->steps && s->index[lo].cycle == cycle ? (int64)lo : -1;
+}
+
+static inline const struct StepStoreStep *stepstore_record(const struct StepStore *s, uint64 step) {
+    return (const struct StepStoreStep *)(s->data + s->index[step].offset);
+}
+
+/// \brief The RAM before step (after the last step for step == steps): its keyframe
+/// plus the writes of the steps in between
+static inline void stepstore_ram(const struct StepStore *s, uint64 step, uint64 *ram) {
+    if (step >= s->header->steps) {
+        memcpy(ram, s->data + s->header->final_offset, RAM_SIZE);
+        return;
+    }
+    uint64 k = s->index[step].keyframe;
+    memcpy(ram, (const uint8 *)stepstore_record(s, k) - RAM_SIZE, RAM_SIZE);
+    for (; k < step; k++) {
+        stepstore_apply(stepstore_record(s, k), ram);
+    }
+}
+
+/// \brief The step as steplog_parse_step would have parsed it from the log
+static inline void stepstore_step(const struct StepStore *s, uint64 step, struct StepRecord *rec) {
+    const struct StepStoreStep *st = stepstore_record(s, step);
+    const struct StepStoreAccess *a = (const struct StepStoreAccess *)(st + 1);
+    stepstore_ram(s, step, rec->ram);
+    rec->access_count = st->access_count;
+    for (uint32 i = 0; i < st->access_count; i++) {
+        rec->access_paddr[i] = a[i].paddr;
+        rec->access_val[i] = a[i].val;
+        rec->access_type[i] = (uint8)a[i].type;
+    }
+}
+
+#endif
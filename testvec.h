@@ -0,0 +1,213 @@
+// Binary test vectors, the compiled form of the .spec files.
+//
+// Include after input-layout.h. A file is a header, the field table of the
+// input layout and the records, all little endian:
+//
+//   struct TestVecHeader                   magic, layout name, counts
+//   struct TestVecField[field_count]       name, byte offset, element size and count
+//   records, from records_offset, record_bytes apart:
+//     struct TestVecRecord                 expected return_value, case name
+//     input_bytes of input                 the fields back to back, as layout_pack
+//                                          writes them: the circuit input bits, LSB first
+//
+// records_offset and record_bytes are multiples of 64, so the input of every
+// record is 64-byte aligned and a mapped file is read in place: a runner
+// points its lanes at the input bytes without parsing or copying anything.
+
+#ifndef TESTVEC_H
+#define TESTVEC_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TESTVEC_MAGIC "RVTVEC01"
+#define TESTVEC_ALIGN 64
+
+struct TestVecHeader {
+    char magic[8];
+    char layout[16];        // mpc_main or rv64i, NUL padded
+    uint32 field_count;
+    uint32 input_bytes;
+    uint64 records_offset;
+    uint64 record_bytes;
+    uint64 count;
+};
+
+struct TestVecField {
+    char name[32];
+    uint32 offset;          // in the input bytes
+    uint32 elem_bytes;
+    uint32 count;
+    uint32 is_signed;
+};
+
+struct TestVecRecord {
+    int64 expected;
+    char name[56];
+};
+
+_Static_assert(sizeof(struct TestVecRecord) == TESTVEC_ALIGN, "the input follows the record header");
+
+static inline uint64 testvec_align(uint64 n) {
+    return (n + TESTVEC_ALIGN - 1) / TESTVEC_ALIGN * TESTVEC_ALIGN;
+}
+
+struct TestVecWriter {
+    FILE *f;
+    const char *path;
+    struct TestVecHeader header;
+};
+
+/// \brief Creates path with the field table of l; returns 0, or -1 with a message on stderr
+static inline int testvec_create(struct TestVecWriter *w, const char *path, const struct InputLayout *l) {
+    memset(w, 0, sizeof(*w));
+    w->path = path;
+    w->f = fopen(path, "wb");
+    if (w->f == NULL) {
+        perror(path);
+        return -1;
+    }
+    struct TestVecHeader *h = &w->header;
+    memcpy(h->magic, TESTVEC_MAGIC, sizeof(h->magic));
+    snprintf(h->layout, sizeof(h->layout), "%s", l->name);
+    h->field_count = l->field_count;
+    h->input_bytes = (uint32)layout_size(l);
+    h->records_offset = testvec_align(sizeof(*h) + (uint64)l->field_count * sizeof(struct TestVecField));
+    h->record_bytes = sizeof(struct TestVecRecord) + testvec_align(h->input_bytes);
+    fwrite(h, sizeof(*h), 1, w->f);
+    uint32 offset = 0;
+    for (uint32 i = 0; i < l->field_count; i++) {
+        struct TestVecField field;
+        memset(&field, 0, sizeof(field));
+        snprintf(field.name, sizeof(field.name), "%s", l->fields[i].name);
+        field.offset = offset;
+        field.elem_bytes = l->fields[i].elem_bytes;
+        field.count = l->fields[i].count;
+        field.is_signed = l->fields[i].is_signed;
+        fwrite(&field, sizeof(field), 1, w->f);
+        offset += field.elem_bytes * field.count;
+    }
+    static const uint8 zero[TESTVEC_ALIGN];
+    fwrite(zero, 1, h->records_offset - ftell(w->f), w->f);
+    return 0;
+}
+
+/// \brief Appends a record; input holds header.input_bytes bytes
+static inline void testvec_add(struct TestVecWriter *w, const char *name, int64 expected, const uint8 *input) {
+    static const uint8 zero[TESTVEC_ALIGN];
+    struct TestVecRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.expected = expected;
+    snprintf(rec.name, sizeof(rec.name), "%s", name);
+    fwrite(&rec, sizeof(rec), 1, w->f);
+    fwrite(input, 1, w->header.input_bytes, w->f);
+    fwrite(zero, 1, w->header.record_bytes - sizeof(rec) - w->header.input_bytes, w->f);
+    w->header.count++;
+}
+
+/// \brief Writes the record count into the header and closes the file; returns 0 or -1
+static inline int testvec_finish(struct TestVecWriter *w) {
+    int ret = 0;
+    if (fseek(w->f, 0, SEEK_SET) != 0 || fwrite(&w->header, sizeof(w->header), 1, w->f) != 1) {
+        ret = -1;
+    }
+    if (fclose(w->f) != 0 || ret != 0) {
+        perror(w->path);
+        ret = -1;
+    }
+    return ret;
+}
+
+struct TestVec {
+    const uint8 *data;
+    size_t size;
+    const struct TestVecHeader *header;
+    const struct TestVecField *fields;
+};
+
+/// \brief Maps the test vector file at path; returns 0, 1 if it is not one
+/// (no message), or -1 with a message on stderr
+static inline int testvec_open(struct TestVec *tv, const char *path) {
+    memset(tv, 0, sizeof(*tv));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    char magic[8];
+    if (st.st_size < (off_t)sizeof(struct TestVecHeader) || pread(fd, magic, 8, 0) != 8 ||
+        memcmp(magic, TESTVEC_MAGIC, 8) != 0) {
+        close(fd);
+        return 1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    tv->data = data;
+    tv->size = st.st_size;
+    tv->header = data;
+    tv->fields = (const struct TestVecField *)(tv->data + sizeof(struct TestVecHeader));
+    const struct TestVecHeader *h = tv->header;
+    if (h->records_offset % TESTVEC_ALIGN != 0 || h->record_bytes % TESTVEC_ALIGN != 0 ||
+        h->record_bytes < sizeof(struct TestVecRecord) + h->input_bytes ||
+        h->records_offset < sizeof(*h) + (uint64)h->field_count * sizeof(struct TestVecField) ||
+        h->records_offset > tv->size || (tv->size - h->records_offset) / h->record_bytes < h->count) {
+        fprintf(stderr, "%s: inconsistent test vector header\n", path);
+        munmap(data, st.st_size);
+        memset(tv, 0, sizeof(*tv));
+        return -1;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+static inline void testvec_close(struct TestVec *tv) {
+    if (tv->data != NULL) {
+        munmap((void *)tv->data, tv->size);
+    }
+    memset(tv, 0, sizeof(*tv));
+}
+
+static inline const struct TestVecRecord *testvec_record(const struct TestVec *tv, uint64 i) {
+    return (const struct TestVecRecord *)(tv->data + tv->header->records_offset + i * tv->header->record_bytes);
+}
+
+/// \brief The input bytes of record i, 64-byte aligned
+static inline const uint8 *testvec_input(const struct TestVec *tv, uint64 i) {
+    return (const uint8 *)(testvec_record(tv, i) + 1);
+}
+
+/// \brief Whether the field table is the one of l, i.e. the file was written by
+/// a build with the same -D flags: the same fields at the same offsets, of the
+/// same sizes and signedness
+static inline bool testvec_matches(const struct TestVec *tv, const struct InputLayout *l) {
+    if (strncmp(tv->header->layout, l->name, sizeof(tv->header->layout)) != 0 ||
+        tv->header->field_count != l->field_count || tv->header->input_bytes != layout_size(l)) {
+        return false;
+    }
+    uint64 offset = 0;
+    for (uint32 i = 0; i < l->field_count; i++) {
+        const struct TestVecField *f = &tv->fields[i];
+        const struct LayoutField *lf = &l->fields[i];
+        if (strncmp(f->name, lf->name, sizeof(f->name)) != 0 || f->offset != offset || f->elem_bytes != lf->elem_bytes ||
+            f->count != lf->count || (f->is_signed != 0) != lf->is_signed) {
+            return false;
+        }
+        offset += (uint64)lf->elem_bytes * lf->count;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,468 @@
+// Native bisection driver.
+//
+// Plays the BISECTION_STEPS rounds of verify_bisection between a prover and a
+// verifier and writes the input of mpc_main for the disputed step. Each party
+// is a step log (rv64ui-uarch-*-steps.json) or a state-root stream (uarch-roots
+// -b: the Merkle root before every cycle). In every round the prover commits
+// to its states at the round's DISSECTION_POINTS cycles (the middle one
+// unless built with DISSECTION_ARITY) and the verifier answers how many of
+// them it agrees with; states are compared as StandardRAMs when both parties
+// have them and as Merkle roots otherwise. Only the states the rounds ask for
+// are read: a step log is searched by its cycle counter (steplog_seek), so a
+// dispute over a multi-gigabyte log touches a few megabytes of it. A step
+// store (stepstore.h, written by uarch-store) stands in for a step log; its
+// states are looked up in its index and rebuilt from the nearest keyframe.
+// With -e the prover is a uarch program instead (a StandardRAM image or the
+// first state of a step log or store), run natively (uarch-emu.h) up to the
+// states the rounds ask for, so no step log has to be generated up front. The
+// run keeps a checkpoint every -i cycles (65536 by default) and a state behind
+// the last one asked for is replayed from the nearest checkpoint, so the
+// rounds take one pass over the run and at most -i steps per state.
+//
+// The input needs the prover's step log. Build the driver with the same -D
+// flags as the circuit; it writes the struct mpc_main takes, field by field in
+// declaration order, every integer little endian, without padding, and
+// reports the return_value mpc_main has on it (verify_native of
+// verify-native.h). -V writes it as a test vector file (testvec.h) for
+// spec-run instead or as well, one record with that return_value.
+//
+// gcc -O2 -o uarch-bisect uarch-bisect.c
+// ./uarch-bisect [-v] [-o input.bin] [-V input.vec] prover-steps.json|.steps verifier-steps.json|.steps|.roots
+// ./uarch-bisect -e [-i interval] [-o input.bin] program.ram verifier-steps.json|.steps|.roots
+
+#define __CPROVER_assume(x) do { } while (0)
+#define RV64I_NATIVE_RAM
+#include "rv64i.c"
+#include "steplog.h"
+#include "stepstore.h"
+#include "uarch-emu.h"
+#include "merkle.h"
+#include "input-layout.h"
+#include "testvec.h"
+#include "verify-native.h"
+
+#include <time.h>
+
+struct Party {
+    const char *path;
+    struct StepLog log;
+    struct StepStore store; // a step store instead; store.data is NULL otherwise
+    struct UarchEmu *emu;   // -e: the program run natively instead, NULL otherwise
+    struct EmuCheckpoints checkpoints;  // -e: its initial state and where it got to
+    bool roots;             // a state-root stream instead of a step log
+    uint64 states;          // states 0 .. states - 1; a halted machine stays in the last one
+    uint64 first_cycle;     // step log, store or program: cycle counter of its first step
+    StandardRAM final_ram;  // step log: the state after its last step
+};
+
+struct State {
+    StandardRAM ram;
+    uint8 root[32];
+    bool have_ram;
+    bool have_root;
+};
+
+static struct MerkleTree tree;
+static struct StepRecord record;
+
+static void fail(const char *fmt, const char *arg) {
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+/// \brief Applies the writes of a parsed step to ram, returns false on a write outside the StandardRAM
+static bool apply_writes(const struct StepRecord *step, uint64 *ram) {
+    for (uint32 i = 0; i < step->access_count; i++) {
+        uint32 word;
+        if (step->access_type[i] != STEPLOG_WRITE) {
+            continue;
+        }
+        if (!steplog_word(step->access_paddr[i], &word)) {
+            return false;
+        }
+        ram[word] = step->access_val[i];
+    }
+    return true;
+}
+
+static void party_open(struct Party *party, const char *path) {
+    party->path = path;
+    int ret = stepstore_open(&party->store, path);
+    if (ret < 0) {
+        exit(2);
+    } else if (ret == 0) {
+        const struct StepStoreHeader *h = party->store.header;
+        party->first_cycle = party->store.index[0].cycle;
+        party->states = party->store.index[h->steps - 1].cycle - party->first_cycle + 2;
+        stepstore_ram(&party->store, h->steps, party->final_ram);
+        return;
+    }
+    if (steplog_open(&party->log, path) != 0) {
+        perror(path);
+        exit(2);
+    }
+    if (party->log.size > 0) {
+        // the rounds seek, readahead for a sequential scan only costs I/O
+        madvise((void *)party->log.data, party->log.size, MADV_RANDOM);
+    }
+    const char *data = party->log.data;
+    const char *end = data + party->log.size;
+    // a root stream is raw bytes and may start like JSON, only a step key makes a step log
+    const char *first = steplog_find_step(data, end, data);
+    party->roots = first == NULL;
+    if (party->roots) {
+        if (party->log.size == 0 || party->log.size % 32 != 0) {
+            fprintf(stderr, "%s: no step found, and %zu bytes are not a stream of 32-byte roots\n", path, party->log.size);
+            exit(2);
+        }
+        party->states = party->log.size / 32;
+        return;
+    }
+    const char *last = steplog_last_step(&party->log);
+    uint64 last_cycle;
+    if (!steplog_step_cycle(first, end, &party->first_cycle) ||
+        !steplog_step_cycle(last, end, &last_cycle) || last_cycle < party->first_cycle) {
+        fail("%s: no steps with increasing cycle counters", path);
+    }
+    if (steplog_parse_step(last, end, &record) == NULL) {
+        fail("%s: cannot parse the last step", path);
+    }
+    memcpy(party->final_ram, record.ram, sizeof(StandardRAM));
+    if (!apply_writes(&record, party->final_ram)) {
+        fail("%s: write outside the StandardRAM in the last step", path);
+    }
+    party->states = last_cycle - party->first_cycle + 2;
+}
+
+static void party_emulate(struct Party *party, const char *path, uint64 interval) {
+    party->path = path;
+    party->emu = malloc(sizeof(struct UarchEmu));
+    if (emu_load(path, party->emu->ram) != 0) {
+        exit(2);
+    }
+    emu_init(party->emu, party->emu->ram);
+    emu_checkpoints_init(&party->checkpoints, party->emu->ram, interval);
+    party->first_cycle = emu_cycle(party->emu);
+    // until the program stops, as many states as the rounds ask for
+    party->states = UINT64_MAX;
+}
+
+/// \brief Runs a program to state k, from the nearest checkpoint when k is behind it
+static void party_run(struct Party *party, uint64 k) {
+    struct UarchEmu *e = party->emu;
+    uint8 trap = emu_seek(e, &party->checkpoints, party->first_cycle + k);
+    if (trap != 0) {
+        fprintf(stderr, "%s: trap %u in the step at cycle %llu\n", party->path, trap,
+            (unsigned long long)emu_cycle(e));
+        exit(2);
+    }
+    if (emu_stopped(e)) {
+        party->states = emu_cycle(e) - party->first_cycle + 1;
+    }
+}
+
+/// \brief Parses the step that starts at state k of a step log (or rebuilds it from a store,
+/// or runs it with its accesses logged) into record
+static void party_step(struct Party *party, uint64 k) {
+    if (party->emu != NULL) {
+        party_run(party, k);
+        if (emu_stopped(party->emu)) {
+            memcpy(record.ram, party->emu->ram, sizeof(StandardRAM));
+            record.access_count = 0;
+        } else if (emu_record(party->emu, &record) != 0) {
+            fprintf(stderr, "%s: the step at cycle %llu traps\n", party->path,
+                (unsigned long long)(party->first_cycle + k));
+            exit(2);
+        }
+        return;
+    }
+    if (party->store.data != NULL) {
+        int64 step = stepstore_find(&party->store, party->first_cycle + k);
+        if (step >= 0) {
+            stepstore_step(&party->store, (uint64)step, &record);
+            return;
+        }
+    }
+    const char *end = party->log.data + party->log.size;
+    const char *s = party->store.data != NULL ? NULL : steplog_seek(&party->log, party->first_cycle + k);
+    if (s == NULL || steplog_parse_step(s, end, &record) == NULL) {
+        fprintf(stderr, "%s: no step with cycle %llu\n", party->path,
+            (unsigned long long)(party->first_cycle + k));
+        exit(2);
+    }
+}
+
+static void party_state(struct Party *party, uint64 k, struct State *state) {
+    if (k >= party->states) {
+        k = party->states - 1;
+    }
+    state->have_ram = !party->roots;
+    state->have_root = party->roots;
+    if (party->roots) {
+        memcpy(state->root, party->log.data + k * 32, 32);
+    } else if (party->emu != NULL) {
+        party_run(party, k);
+        memcpy(state->ram, party->emu->ram, sizeof(StandardRAM));
+    } else if (k == party->states - 1) {
+        memcpy(state->ram, party->final_ram, sizeof(StandardRAM));
+    } else {
+        party_step(party, k);
+        memcpy(state->ram, record.ram, sizeof(StandardRAM));
+    }
+}
+
+static const uint8 *state_root(struct State *state) {
+    if (!state->have_root) {
+        merkle_init(&tree, state->ram);
+        memcpy(state->root, merkle_update(&tree), 32);
+        state->have_root = true;
+    }
+    return state->root;
+}
+
+static bool states_equal(struct State *a, struct State *b) {
+    if (a->have_ram && b->have_ram) {
+        return memcmp(a->ram, b->ram, sizeof(StandardRAM)) == 0;
+    }
+    return memcmp(state_root(a), state_root(b), 32) == 0;
+}
+
+/// \brief The access log of the step in record in the layout of struct Input
+static void step_accesses(struct BisectInput *in) {
+    struct Input step;
+    if (!steplog_input(&record, &step)) {
+        fprintf(stderr, "the disputed step has %u accesses, ACCESS_LOG_SIZE is %d\n",
+            record.access_count, ACCESS_LOG_SIZE);
+        exit(2);
+    }
+    memcpy(in->access_paddr, step.access_paddr, sizeof(in->access_paddr));
+    memcpy(in->access_val, step.access_val, sizeof(in->access_val));
+    memcpy(in->access_readWriteEnd, step.access_readWriteEnd, sizeof(in->access_readWriteEnd));
+}
+
+#if defined(RV64I_MERKLE)
+static void ram_root(const uint64 *ram, uint8 *root) {
+    merkle_init(&tree, ram);
+    memcpy(root, merkle_update(&tree), 32);
+}
+
+/// \brief The commitment input for the same dispute: roots for the snapshots and
+/// the Merkle paths of the accesses, each against the root before it
+static void merkle_input(const struct BisectInput *in, struct MerkleBisectInput *out) {
+    memset(out, 0, sizeof(*out));
+    ram_root(in->ram_disagree, out->root_disagree);
+    for (int j = 0; j < BISECTION_SNAPSHOTS; j++) {
+        ram_root(in->prover_bisection_RAM[j], out->prover_bisection_root[j]);
+    }
+    memcpy(out->access_paddr, in->access_paddr, sizeof(out->access_paddr));
+    memcpy(out->access_val, in->access_val, sizeof(out->access_val));
+    memcpy(out->access_readWriteEnd, in->access_readWriteEnd, sizeof(out->access_readWriteEnd));
+    ram_root(in->ram, out->root);
+    for (int i = 0; i < ACCESS_LOG_SIZE && in->access_readWriteEnd[i] != 2; i++) {
+        uint32 word = (uint32)(ramOffset(in->access_paddr[i]) / 8);
+        merkle_siblings(&tree, word, out->access_siblings[i]);
+        if (in->access_readWriteEnd[i] == 1) {
+            out->access_prev_val[i] = tree.word[word];
+            merkle_set(&tree, word, in->access_val[i]);
+            merkle_update(&tree);
+        }
+    }
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    memcpy(out->verifier_bisections, in->verifier_bisections, sizeof(out->verifier_bisections));
+#endif
+}
+#endif
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL, *vectors = NULL;
+    bool verbose = false, emulate = false;
+    uint64 interval = 1 << 16;
+    int opt;
+    while ((opt = getopt(argc, argv, "ei:o:V:v")) != -1) {
+        if (opt == 'e') {
+            emulate = true;
+        } else if (opt == 'i') {
+            interval = strtoull(optarg, NULL, 0);
+        } else if (opt == 'o') {
+            output = optarg;
+        } else if (opt == 'V') {
+            vectors = optarg;
+        } else if (opt == 'v') {
+            verbose = true;
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind + 2 != argc) {
+        fprintf(stderr, "usage: %s [-e [-i interval]] [-v] [-o input.bin] [-V input.vec] prover verifier\n"
+            "  prover, verifier: a step log, a step store or a uarch-roots -b root stream\n"
+            "  -e: the prover is a program to run, a RAM image or the first state of a log or store\n", argv[0]);
+        return 2;
+    }
+    double t0 = now();
+    static struct Party prover, verifier;
+    if (emulate) {
+        party_emulate(&prover, argv[optind], interval);
+    } else {
+        party_open(&prover, argv[optind]);
+    }
+    party_open(&verifier, argv[optind + 1]);
+
+    // the initial state is common to both parties, the rounds never ask for it
+    struct State *claim = malloc(sizeof(struct State));
+    struct State *mine = malloc(sizeof(struct State));
+    party_state(&prover, 0, claim);
+    party_state(&verifier, 0, mine);
+    if (!states_equal(claim, mine)) {
+        fprintf(stderr, "the parties disagree on the initial state\n");
+        return 1;
+    }
+
+    // has to match bisectionSnapshots in rv64i.c: every round the prover commits
+    // DISSECTION_POINTS states and the verifier answers how many of them it agrees with
+    struct BisectInput *in = calloc(1, sizeof(struct BisectInput));
+    uint8 answer[BISECTION_STEPS];
+    StandardRAM *snapshot = calloc(BISECTION_STEPS * DISSECTION_POINTS, sizeof(StandardRAM));
+    int left = 0;
+    int right = DISSECTION_RIGHT;
+    int lastAgree = 0;
+    int lastDisagree = MAX_CYCLE;
+    for (int i = 0; i < BISECTION_STEPS; i++) {
+        int point[DISSECTION_POINTS + 1];
+        int agreed = 0;
+        bool disagreed = false;
+        for (int j = 1; j <= DISSECTION_POINTS; j++) {
+            point[j] = dissectionPoint(left, right, j);
+            party_state(&prover, point[j], claim);
+            if (claim->have_ram) {
+                memcpy(snapshot[i * DISSECTION_POINTS + j - 1], claim->ram, sizeof(StandardRAM));
+            }
+            if (!disagreed) {
+                party_state(&verifier, point[j], mine);
+                disagreed = !states_equal(claim, mine);
+                agreed += !disagreed;
+            }
+        }
+        answer[i] = agreed;
+        if (verbose) {
+            fprintf(stderr, "round %2d: cycles %10d .. %10d, agrees with %d of %d\n", i, point[1],
+                point[DISSECTION_POINTS], answer[i], DISSECTION_POINTS);
+        }
+        if (agreed > 0) {
+            lastAgree = point[agreed];
+            left = lastAgree + 1;
+        }
+        if (agreed < DISSECTION_POINTS) {
+            lastDisagree = point[agreed + 1];
+            right = lastDisagree - 1;
+        }
+    }
+    if (lastDisagree == MAX_CYCLE) {
+        fprintf(stderr, "the parties agree on every state up to cycle %d\n", MAX_CYCLE);
+        return 1;
+    }
+    if (lastAgree + 1 != lastDisagree) {
+        fprintf(stderr, "the bisection ended on cycles %d and %d, not on one step\n", lastAgree, lastDisagree);
+        return 1;
+    }
+    fprintf(stderr, "disputed step: cycle %d (%s)\n", lastAgree,
+        (uint64)lastAgree + 1 < prover.states ? "the prover's step" : "after the prover halted");
+    if (verbose && prover.emu != NULL) {
+        fprintf(stderr, "emulated %llu steps, %llu checkpoints every %llu cycles\n",
+            (unsigned long long)prover.emu->steps, (unsigned long long)prover.checkpoints.count,
+            (unsigned long long)prover.checkpoints.interval);
+    }
+
+    int ret = 0;
+    if (output != NULL || vectors != NULL) {
+        if (prover.roots) {
+            fail("%s: the input needs the prover's step log, not its roots", prover.path);
+        }
+        party_state(&prover, lastAgree + 1, claim);
+        memcpy(in->ram_disagree, claim->ram, sizeof(StandardRAM));
+        party_state(&prover, lastAgree, claim);
+        memcpy(in->ram, claim->ram, sizeof(StandardRAM));
+#ifdef BISECTION_SCHEDULE_PUBLIC
+        memcpy(in->prover_bisection_RAM[AGREE_SNAPSHOT], in->ram, sizeof(StandardRAM));
+        memcpy(in->prover_bisection_RAM[DISAGREE_SNAPSHOT], in->ram_disagree, sizeof(StandardRAM));
+#else
+        memcpy(in->prover_bisection_RAM, snapshot, sizeof(in->prover_bisection_RAM));
+        memcpy(in->verifier_bisections, answer, sizeof(in->verifier_bisections));
+#endif
+        if ((uint64)lastAgree + 1 < prover.states) {
+            party_step(&prover, lastAgree);
+        } else {
+            // a halted machine does not step: an empty access log
+            record.access_count = 0;
+        }
+        step_accesses(in);
+
+#if defined(RV64I_PACKED_INPUT)
+        MpcInput *mpc = calloc(1, sizeof(MpcInput));
+        if (!packBisectInput(in, mpc)) {
+            fprintf(stderr, "the disputed step accesses memory outside the StandardRAM\n");
+            return 2;
+        }
+#elif defined(RV64I_MERKLE)
+        MpcInput *mpc = malloc(sizeof(MpcInput));
+        merkle_input(in, mpc);
+#else
+        MpcInput *mpc = in;
+#endif
+        ret = verify_native(mpc);
+        if (output != NULL) {
+            FILE *out = fopen(output, "wb");
+            if (out == NULL) {
+                perror(output);
+                return 2;
+            }
+            layout_write(out, &mpc_input_layout, mpc);
+            if (fclose(out) != 0) {
+                perror(output);
+                return 2;
+            }
+            fprintf(stderr, "wrote %s, mpc_main returns %d\n", output, ret);
+        }
+        if (vectors != NULL) {
+            struct TestVecWriter w;
+            char name[sizeof(((struct TestVecRecord *)0)->name)];
+            uint8 *packed = malloc(layout_size(&mpc_input_layout));
+            snprintf(name, sizeof(name), "%s@%d", strrchr(prover.path, '/') ? strrchr(prover.path, '/') + 1 :
+                prover.path, lastAgree);
+            layout_pack(&mpc_input_layout, mpc, packed);
+            if (testvec_create(&w, vectors, &mpc_input_layout) != 0) {
+                return 2;
+            }
+            testvec_add(&w, name, ret, packed);
+            if (testvec_finish(&w) != 0) {
+                return 2;
+            }
+            free(packed);
+            fprintf(stderr, "wrote %s, mpc_main returns %d\n", vectors, ret);
+        }
+        if (mpc != (MpcInput *)in) {
+            free(mpc);
+        }
+    }
+    fprintf(stderr, "%.3f ms\n", (now() - t0) * 1e3);
+
+    free(snapshot);
+    free(in);
+    free(mine);
+    free(claim);
+    steplog_close(&verifier.log);
+    steplog_close(&prover.log);
+    stepstore_close(&verifier.store);
+    stepstore_close(&prover.store);
+    free(prover.emu);
+    emu_checkpoints_free(&prover.checkpoints);
+    return 0;
+}
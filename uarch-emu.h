@@ -0,0 +1,316 @@
+// Native uarch emulator: the uarch_step of rv64i.c, executeXXX semantics and
+// all, with its accesses going to a StandardRAM instead of being checked
+// against an access log.
+//
+// Build with -D RV64I_NATIVE_RAM (before including rv64i.c) and include after
+// steplog.h and stepstore.h. The emulator holds one StandardRAM and steps it
+// in place; a caller that wants the state at some cycles runs to each of them
+// in turn and copies the RAM out, so a snapshot costs one StandardRAM and no
+// step in between is logged. emu_record steps once with the access log
+// recorded, for the disputed step of a bisection.
+//
+// Checkpoints: a run that keeps an EmuCheckpoints records its state every
+// interval cycles, as the StandardRAM words (the registers at UX0, UPC,
+// UCYCLE, UHALT and the RAM page) that differ from the initial state, and
+// emu_seek resumes from the nearest checkpoint at or before the cycle asked
+// for. Going back costs at most interval steps and going forward past the last
+// checkpoint lays down new ones, so any sequence of seeks replays one pass up
+// to the furthest cycle plus at most interval steps per seek. A checkpoint
+// file (emu_checkpoints_open) lets a later run resume where this one got to,
+// little endian:
+//
+//   struct EmuCheckpointHeader             magic, RAM_SIZE, interval
+//   StandardRAM                            the initial state
+//   per checkpoint: uint64 cycle, uint64 count, struct EmuWord[count]
+
+#ifndef UARCH_EMU_H
+#define UARCH_EMU_H
+
+struct UarchEmu {
+    StandardRAM ram;
+    UarchState state;
+    uint64 steps;               // taken by emu_run, replays and all
+};
+
+/// \brief Starts e at the state in ram, which may be e->ram
+static inline void emu_init(struct UarchEmu *e, const uint64 *ram) {
+    if (ram != e->ram) {
+        memcpy(e->ram, ram, sizeof(StandardRAM));
+    }
+    memset(&e->state, 0, sizeof(e->state));
+    e->state.ram = e->ram;
+    e->steps = 0;
+}
+
+static inline uint64 emu_cycle(const struct UarchEmu *e) {
+    return e->ram[UCYCLE / 8];
+}
+
+/// \brief Whether uarch_step leaves the state as it is: halted or at the last cycle
+static inline bool emu_stopped(const struct UarchEmu *e) {
+    return e->ram[UHALT / 8] != 0 || e->ram[UCYCLE / 8] == UINT64_MAX;
+}
+
+/// \brief Steps until the cycle counter reaches cycle or the machine stops; returns 0,
+/// or the trap of a step that failed, whose writes up to the trap are in the RAM
+__attribute__((flatten)) static inline uint8 emu_run(struct UarchEmu *e, uint64 cycle) {
+    UarchState *a = &e->state;
+    uint64 start = e->ram[UCYCLE / 8];
+    uint8 trap = 0;
+    while (e->ram[UCYCLE / 8] < cycle) {
+        enum UArchStepStatus status = uarch_step(a);
+        if (a->trap != 0) {
+            trap = a->trap;
+            break;
+        }
+        if (status != Success) {
+            break;
+        }
+    }
+    e->steps += e->ram[UCYCLE / 8] - start;
+    return trap;
+}
+
+/// \brief Takes one step with its accesses logged into rec, and the RAM before it;
+/// returns 0 or the trap. A stopped machine logs the reads that find it stopped.
+static inline uint8 emu_record(struct UarchEmu *e, struct StepRecord *rec) {
+    UarchState *a = &e->state;
+    memcpy(rec->ram, e->ram, sizeof(StandardRAM));
+    a->record = true;
+    a->access_pointer = 0;
+    uarch_step(a);
+    a->record = false;
+    rec->access_count = a->access_pointer < STEPLOG_MAX_ACCESSES ? a->access_pointer : STEPLOG_MAX_ACCESSES;
+    for (uint32 i = 0; i < rec->access_count && i < ACCESS_LOG_SIZE; i++) {
+        rec->access_paddr[i] = a->access_paddr[i];
+        rec->access_val[i] = a->access_val[i];
+        rec->access_type[i] = a->access_readWriteEnd[i];
+    }
+    return a->trap;
+}
+
+/// \brief Reads the initial state of a uarch program: a raw StandardRAM image, the
+/// first step of a step log or of a step store; returns 0 or -1 with a message on stderr
+static inline int emu_load(const char *path, uint64 *ram) {
+    struct StepStore store;
+    int ret = stepstore_open(&store, path);
+    if (ret <= 0) {
+        if (ret == 0) {
+            stepstore_ram(&store, 0, ram);
+            stepstore_close(&store);
+        }
+        return ret;
+    }
+    struct StepLog log;
+    if (steplog_open(&log, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    const char *end = log.data + log.size;
+    const char *p = steplog_ws(log.data, end);
+    ret = 0;
+    if (p < end && *p == '{') {
+        struct StepRecord *rec = malloc(sizeof(struct StepRecord));
+        const char *first = steplog_find_step(log.data, end, log.data);
+        if (first == NULL || steplog_parse_step(first, end, rec) == NULL) {
+            fprintf(stderr, "%s: cannot parse the first step\n", path);
+            ret = -1;
+        } else {
+            memcpy(ram, rec->ram, sizeof(StandardRAM));
+        }
+        free(rec);
+    } else if (log.size == sizeof(StandardRAM)) {
+        memcpy(ram, log.data, sizeof(StandardRAM));
+    } else {
+        fprintf(stderr, "%s: neither a step log, a step store nor a %d-byte RAM image\n", path, RAM_SIZE);
+        ret = -1;
+    }
+    steplog_close(&log);
+    return ret;
+}
+
+#define EMU_CHECKPOINT_MAGIC "RVCKPT01"
+
+struct EmuCheckpointHeader {
+    char magic[8];
+    uint32 ram_bytes;
+    uint32 reserved;
+    uint64 interval;
+};
+
+struct EmuWord {
+    uint64 word;
+    uint64 val;
+};
+
+struct EmuCheckpoint {
+    uint64 cycle;
+    uint64 count;
+    struct EmuWord *words;      // the words that differ from the initial state
+};
+
+struct EmuCheckpoints {
+    StandardRAM initial;
+    uint64 interval;
+    struct EmuCheckpoint *at;   // at[i] is the state at cycle at[0].cycle + i * interval
+    uint64 count;
+    uint64 cap;
+    FILE *f;                    // the checkpoint file they also go to, or NULL
+};
+
+static inline void emu_checkpoint_write(FILE *f, const struct EmuCheckpoint *c) {
+    fwrite(&c->cycle, sizeof(uint64), 1, f);
+    fwrite(&c->count, sizeof(uint64), 1, f);
+    fwrite(c->words, sizeof(struct EmuWord), c->count, f);
+    fflush(f);
+}
+
+/// \brief Appends the state of e as the next checkpoint
+static inline void emu_checkpoint_add(struct EmuCheckpoints *cps, const struct UarchEmu *e) {
+    if (cps->count == cps->cap) {
+        cps->cap = cps->cap ? cps->cap * 2 : 64;
+        cps->at = realloc(cps->at, cps->cap * sizeof(struct EmuCheckpoint));
+    }
+    struct EmuCheckpoint *c = &cps->at[cps->count++];
+    c->cycle = emu_cycle(e);
+    c->count = 0;
+    for (uint32 i = 0; i < RAM_SIZE / 8; i++) {
+        c->count += e->ram[i] != cps->initial[i];
+    }
+    c->words = malloc(c->count * sizeof(struct EmuWord) + 1);
+    for (uint32 i = 0, n = 0; i < RAM_SIZE / 8; i++) {
+        if (e->ram[i] != cps->initial[i]) {
+            c->words[n].word = i;
+            c->words[n++].val = e->ram[i];
+        }
+    }
+    if (cps->f != NULL) {
+        emu_checkpoint_write(cps->f, c);
+    }
+}
+
+/// \brief Keeps checkpoints in memory for the program in ram, the first at its initial state
+static inline void emu_checkpoints_init(struct EmuCheckpoints *cps, const uint64 *ram, uint64 interval) {
+    memset(cps, 0, sizeof(*cps));
+    memcpy(cps->initial, ram, sizeof(StandardRAM));
+    cps->interval = interval > 0 ? interval : 1;
+    struct UarchEmu *e = malloc(sizeof(struct UarchEmu));
+    emu_init(e, ram);
+    emu_checkpoint_add(cps, e);
+    free(e);
+}
+
+/// \brief Keeps the checkpoints of the program in ram in the file at path as well: a new
+/// file is started, an existing one of the same program is read and its checkpoints resumed
+/// (a record cut short by an interrupted run is dropped); returns 0 or -1 with a message on stderr
+static inline int emu_checkpoints_open(struct EmuCheckpoints *cps, const char *path, const uint64 *ram,
+    uint64 interval) {
+    struct EmuCheckpointHeader h;
+    FILE *f = fopen(path, "r+b");
+    if (f == NULL) {
+        emu_checkpoints_init(cps, ram, interval);
+        if ((cps->f = fopen(path, "wb")) == NULL) {
+            perror(path);
+            return -1;
+        }
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, EMU_CHECKPOINT_MAGIC, sizeof(h.magic));
+        h.ram_bytes = RAM_SIZE;
+        h.interval = cps->interval;
+        fwrite(&h, sizeof(h), 1, cps->f);
+        fwrite(cps->initial, sizeof(StandardRAM), 1, cps->f);
+        emu_checkpoint_write(cps->f, &cps->at[0]);
+        return 0;
+    }
+    memset(cps, 0, sizeof(*cps));
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, EMU_CHECKPOINT_MAGIC, sizeof(h.magic)) != 0 ||
+        h.ram_bytes != RAM_SIZE || h.interval == 0 || fread(cps->initial, sizeof(StandardRAM), 1, f) != 1) {
+        fprintf(stderr, "%s: not a checkpoint file of a %d-byte RAM\n", path, RAM_SIZE);
+        fclose(f);
+        return -1;
+    }
+    if (memcmp(cps->initial, ram, sizeof(StandardRAM)) != 0) {
+        fprintf(stderr, "%s: the checkpoints of another program\n", path);
+        fclose(f);
+        return -1;
+    }
+    cps->interval = h.interval;
+    long end = ftell(f);
+    struct EmuCheckpoint c;
+    while (fread(&c.cycle, sizeof(uint64), 1, f) == 1 && fread(&c.count, sizeof(uint64), 1, f) == 1 &&
+        c.count <= RAM_SIZE / 8) {
+        c.words = malloc(c.count * sizeof(struct EmuWord) + 1);
+        if (fread(c.words, sizeof(struct EmuWord), c.count, f) != c.count) {
+            free(c.words);
+            break;
+        }
+        if (cps->count == cps->cap) {
+            cps->cap = cps->cap ? cps->cap * 2 : 64;
+            cps->at = realloc(cps->at, cps->cap * sizeof(struct EmuCheckpoint));
+        }
+        cps->at[cps->count++] = c;
+        end = ftell(f);
+    }
+    if (cps->count == 0) {
+        fprintf(stderr, "%s: no checkpoints\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (fseek(f, end, SEEK_SET) != 0 || ftruncate(fileno(f), end) != 0) {
+        perror(path);
+        fclose(f);
+        return -1;
+    }
+    cps->f = f;
+    return 0;
+}
+
+static inline void emu_checkpoints_free(struct EmuCheckpoints *cps) {
+    for (uint64 i = 0; i < cps->count; i++) {
+        free(cps->at[i].words);
+    }
+    free(cps->at);
+    if (cps->f != NULL && fclose(cps->f) != 0) {
+        perror("checkpoints");
+    }
+    memset(cps, 0, sizeof(*cps));
+}
+
+/// \brief Restores the state of checkpoint i into e
+static inline void emu_restore(struct UarchEmu *e, const struct EmuCheckpoints *cps, uint64 i) {
+    memcpy(e->ram, cps->initial, sizeof(StandardRAM));
+    const struct EmuCheckpoint *c = &cps->at[i];
+    for (uint64 n = 0; n < c->count; n++) {
+        e->ram[c->words[n].word] = c->words[n].val;
+    }
+    // a trap or access log of the step before the restore is not the restored machine's
+    memset(&e->state, 0, sizeof(e->state));
+    e->state.ram = e->ram;
+}
+
+/// \brief Brings e to cycle (or where the machine stops before it), from where e is if
+/// that is on the way and from the nearest checkpoint otherwise, laying down checkpoints
+/// past the last one; returns 0 or the trap of a step that failed
+static inline uint8 emu_seek(struct UarchEmu *e, struct EmuCheckpoints *cps, uint64 cycle) {
+    uint64 start = cps->at[0].cycle;
+    uint64 i = cycle > start ? (cycle - start) / cps->interval : 0;
+    if (i >= cps->count) {
+        i = cps->count - 1;
+    }
+    if (emu_cycle(e) > cycle || emu_cycle(e) < cps->at[i].cycle) {
+        emu_restore(e, cps, i);
+    }
+    while (emu_cycle(e) < cycle && !emu_stopped(e)) {
+        uint64 next = start + cps->count * cps->interval;
+        uint8 trap = emu_run(e, next < cycle ? next : cycle);
+        if (trap != 0) {
+            return trap;
+        }
+        if (emu_cycle(e) == next) {
+            emu_checkpoint_add(cps, e);
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+// Per-cycle Merkle roots of a uarch step log.
+//
+// Builds the Keccak256 Merkle tree of the first step's circuit_ram once and
+// then only applies the logged writes of every step to it (merkle.h), which
+// gives the root before every step and after the last one: the root stream a
+// RV64I_MERKLE bisection commits to. Every step's circuit_ram is compared with
+// the incrementally maintained words; with -c the tree is also rebuilt from
+// scratch at every step to check the incremental hashes.
+//
+// gcc -O2 -o uarch-roots uarch-roots.c
+// ./uarch-roots [-b] [-c] rv64ui-uarch-simple-steps.json > roots
+//
+// The roots are printed in hex, one per line, or with -b as 32 raw bytes each.
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "steplog.h"
+#include "merkle.h"
+
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void emit(const uint8 *root, bool binary) {
+    if (binary) {
+        fwrite(root, 1, 32, stdout);
+        return;
+    }
+    for (int i = 0; i < 32; i++) {
+        printf("%02x", root[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool binary = false, check = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "bc")) != -1) {
+        if (opt == 'b') {
+            binary = true;
+        } else if (opt == 'c') {
+            check = true;
+        } else {
+            fprintf(stderr, "usage: %s [-b] [-c] steps.json\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-b] [-c] steps.json\n", argv[0]);
+        return 2;
+    }
+    struct StepLog log;
+    if (steplog_open(&log, argv[optind]) != 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+    const char *end = log.data + log.size;
+    struct StepRecord *step = malloc(sizeof(struct StepRecord));
+    struct MerkleTree *tree = malloc(sizeof(struct MerkleTree));
+    struct MerkleTree *fresh = check ? malloc(sizeof(struct MerkleTree)) : NULL;
+
+    uint64 steps = 0;
+    int ret = 0;
+    double update_time = 0;
+    const char *p = steplog_find_step(log.data, end, log.data);
+    while (p != NULL) {
+        p = steplog_parse_step(p, end, step);
+        if (p == NULL) {
+            fprintf(stderr, "parse error in step %llu\n", (unsigned long long)steps);
+            ret = 1;
+            break;
+        }
+        if (steps == 0) {
+            merkle_init(tree, step->ram);
+        } else if (memcmp(tree->word, step->ram, sizeof(tree->word)) != 0) {
+            fprintf(stderr, "step %llu: circuit_ram differs from the previous step plus its writes\n",
+                (unsigned long long)steps);
+            ret = 1;
+            break;
+        }
+        if (fresh != NULL) {
+            merkle_init(fresh, step->ram);
+            if (memcmp(fresh->node[1], tree->node[1], 32) != 0) {
+                fprintf(stderr, "step %llu: incremental root differs from the rebuilt tree\n",
+                    (unsigned long long)steps);
+                ret = 1;
+                break;
+            }
+        }
+        emit(tree->node[1], binary);
+
+        double t0 = now();
+        if (!merkle_apply_writes(tree, step->access_paddr, step->access_val, step->access_type,
+                step->access_count)) {
+            fprintf(stderr, "step %llu: write outside the StandardRAM\n", (unsigned long long)steps);
+            ret = 1;
+            break;
+        }
+        merkle_update(tree);
+        update_time += now() - t0;
+        steps++;
+
+        p = steplog_ws(p, end);
+        if (p < end && *p == ',') {
+            p = steplog_ws(p + 1, end);
+        }
+        if (p >= end || *p != '{') {
+            p = NULL;
+        }
+    }
+    if (ret == 0 && steps > 0) {
+        emit(tree->node[1], binary);
+    }
+    fprintf(stderr, "%llu steps, %llu roots, %.2f us/step for the tree updates\n",
+        (unsigned long long)steps, (unsigned long long)(ret == 0 && steps > 0 ? steps + 1 : steps),
+        steps > 0 ? update_time / steps * 1e6 : 0.0);
+
+    free(fresh);
+    free(tree);
+    free(step);
+    steplog_close(&log);
+    return ret == 0 && steps > 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+// Runs a uarch program natively (uarch-emu.h) and snapshots its state only at
+// the cycles asked for.
+//
+// The program is a raw StandardRAM image or the first state of a step log or
+// step store. It runs until it halts, or for -n cycles; with -c the states
+// before the listed cycles are written to -o, with -p those at the
+// power-of-two cycles from the start (start, +1, +2, +4, ...), and the run
+// ends at the last of them. A snapshot is
+// the raw StandardRAM, its cycle is in it (UCYCLE), so the file is one
+// snapshot after the other and holding one costs 8 KB whatever the run length.
+// With -k the run keeps a checkpoint file, a checkpoint every -i cycles
+// (2^20 by default, uarch-emu.h): a run of the same program with the same file
+// resumes from the nearest checkpoint before its first cycle instead of cycle
+// 0, and a run that is stopped or killed loses at most -i cycles of work.
+// -C checks the emulator against a step log of the same program instead: the
+// RAM before every step and its access log have to be the logged ones.
+//
+// gcc -O2 -o uarch-run uarch-run.c
+// ./uarch-run [-n cycles] [-c cycle,...] [-p] [-o snapshots] [-k checkpoints [-i interval]] program.ram|steps.json|.steps
+// ./uarch-run -C rv64ui-uarch-simple-steps.json
+
+#define __CPROVER_assume(x) do { } while (0)
+#define RV64I_NATIVE_RAM
+#include "rv64i.c"
+#include "steplog.h"
+#include "stepstore.h"
+#include "uarch-emu.h"
+
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64 x = *(const uint64 *)a, y = *(const uint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/// \brief Steps the emulator along a step log; returns 0 if every step matches
+static int check(const char *path) {
+    struct StepLog log;
+    if (steplog_open(&log, path) != 0) {
+        perror(path);
+        return 2;
+    }
+    const char *end = log.data + log.size;
+    struct StepRecord *logged = malloc(sizeof(struct StepRecord));
+    struct StepRecord *ran = malloc(sizeof(struct StepRecord));
+    struct UarchEmu *e = malloc(sizeof(struct UarchEmu));
+    uint64 steps = 0;
+    int ret = 0;
+    for (const char *p = steplog_find_step(log.data, end, log.data); p != NULL && ret == 0;
+         p = steplog_find_step(p, end, log.data)) {
+        p = steplog_parse_step(p, end, logged);
+        if (p == NULL) {
+            fprintf(stderr, "%s: parse error after %llu steps\n", path, (unsigned long long)steps);
+            ret = 2;
+            break;
+        }
+        if (steps == 0) {
+            emu_init(e, logged->ram);
+        } else if (memcmp(e->ram, logged->ram, sizeof(StandardRAM)) != 0) {
+            fprintf(stderr, "%s: the RAM before step %llu differs\n", path, (unsigned long long)steps);
+            ret = 1;
+            break;
+        }
+        uint8 trap = emu_record(e, ran);
+        bool same = trap == 0 && ran->access_count == logged->access_count;
+        for (uint32 i = 0; same && i < ran->access_count; i++) {
+            same = ran->access_paddr[i] == logged->access_paddr[i] && ran->access_val[i] == logged->access_val[i] &&
+                ran->access_type[i] == logged->access_type[i];
+        }
+        if (!same) {
+            fprintf(stderr, "%s: step %llu (cycle %llu) differs from the log, trap %u\n", path,
+                (unsigned long long)steps, (unsigned long long)logged->ram[UCYCLE / 8], trap);
+            ret = 1;
+        }
+        steps++;
+    }
+    if (ret == 0) {
+        fprintf(stderr, "%s: %llu steps match\n", path, (unsigned long long)steps);
+    }
+    free(e);
+    free(ran);
+    free(logged);
+    steplog_close(&log);
+    return ret;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n cycles] [-c cycle,...] [-p] [-o snapshots] [-k checkpoints [-i interval]] program\n"
+        "       %s -C steps.json\n"
+        "  program: a StandardRAM image, a step log or a step store\n", name, name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL, *checked = NULL, *checkpoint_path = NULL;
+    uint64 limit = MAX_CYCLE, interval = 1 << 20;
+    uint64 *cycles = NULL;
+    size_t cycle_count = 0;
+    bool powers = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "C:c:i:k:n:o:p")) != -1) {
+        switch (opt) {
+        case 'C': checked = optarg; break;
+        case 'c':
+            for (char *s = optarg; *s != '\0'; s += *s == ',') {
+                cycles = realloc(cycles, (cycle_count + 1) * sizeof(uint64));
+                cycles[cycle_count++] = strtoull(s, &s, 0);
+                if (*s != ',' && *s != '\0') {
+                    usage(argv[0]);
+                }
+            }
+            break;
+        case 'i': interval = strtoull(optarg, NULL, 0); break;
+        case 'k': checkpoint_path = optarg; break;
+        case 'n': limit = strtoull(optarg, NULL, 0); break;
+        case 'o': output = optarg; break;
+        case 'p': powers = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (checked != NULL) {
+        if (optind != argc) {
+            usage(argv[0]);
+        }
+        return check(checked);
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+    }
+    struct UarchEmu *e = malloc(sizeof(struct UarchEmu));
+    if (emu_load(argv[optind], e->ram) != 0) {
+        return 2;
+    }
+    emu_init(e, e->ram);
+    struct EmuCheckpoints checkpoints;
+    if (checkpoint_path != NULL && emu_checkpoints_open(&checkpoints, checkpoint_path, e->ram, interval) != 0) {
+        return 2;
+    }
+    uint64 start = emu_cycle(e);
+    uint64 stop = start + limit;
+    if (powers) {
+        for (uint64 d = 0; d <= limit; d = d == 0 ? 1 : d * 2) {
+            cycles = realloc(cycles, (cycle_count + 1) * sizeof(uint64));
+            cycles[cycle_count++] = start + d;
+        }
+    }
+    qsort(cycles, cycle_count, sizeof(uint64), compare_u64);
+    FILE *out = NULL;
+    if (output != NULL && (out = fopen(output, "wb")) == NULL) {
+        perror(output);
+        return 2;
+    }
+
+    double t0 = now();
+    uint8 trap = 0;
+    size_t snapshots = 0;
+    for (size_t i = 0; i < cycle_count && cycles[i] <= stop && trap == 0; i++) {
+        if (i > 0 && cycles[i] == cycles[i - 1]) {
+            continue;
+        }
+        trap = checkpoint_path != NULL ? emu_seek(e, &checkpoints, cycles[i]) : emu_run(e, cycles[i]);
+        if (trap == 0) {
+            // the state before cycles[i]: a stopped machine stays in its last one
+            printf("cycle %llu: pc 0x%llx%s\n", (unsigned long long)cycles[i], (unsigned long long)e->ram[UPC / 8],
+                emu_stopped(e) ? ", halted" : "");
+            if (out != NULL) {
+                fwrite(e->ram, sizeof(StandardRAM), 1, out);
+            }
+            snapshots++;
+        }
+    }
+    // without snapshots to take, the run goes on to the end
+    if (cycle_count == 0) {
+        trap = checkpoint_path != NULL ? emu_seek(e, &checkpoints, stop) : emu_run(e, stop);
+    }
+    double t = now() - t0;
+    uint64 steps = e->steps;
+    if (out != NULL && fclose(out) != 0) {
+        perror(output);
+        return 2;
+    }
+    fprintf(stderr, "%llu steps in %.3f s (%.1f M steps/s), %s at cycle %llu, pc 0x%llx; %zu snapshots\n",
+        (unsigned long long)steps, t, steps / t / 1e6, trap != 0 ? "trapped" : emu_stopped(e) ? "halted" : "stopped",
+        (unsigned long long)emu_cycle(e), (unsigned long long)e->ram[UPC / 8], snapshots);
+    if (trap != 0) {
+        fprintf(stderr, "trap %u in the step at cycle %llu\n", trap, (unsigned long long)emu_cycle(e));
+        return 1;
+    }
+    if (checkpoint_path != NULL) {
+        fprintf(stderr, "%s: %llu checkpoints every %llu cycles\n", checkpoint_path,
+            (unsigned long long)checkpoints.count, (unsigned long long)checkpoints.interval);
+        emu_checkpoints_free(&checkpoints);
+    }
+    free(cycles);
+    free(e);
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Packs a step log into an indexed step store (stepstore.h).
+//
+// The steps are read in order, their cycle counters have to increase; every
+// step keeps its access log and the store its RAM as a keyframe every
+// -k steps (64 by default) plus the writes in between. uarch-bisect takes the
+// store wherever it takes the step log. With -c cycle the tool reads a store
+// back instead and prints the RAM words before that cycle that differ from
+// the first step's, and the step's accesses. Build with the same -D flags as
+// uarch-bisect.
+//
+// gcc -O2 -o uarch-store uarch-store.c
+// ./uarch-store [-k interval] -o prover.steps prover-steps.json
+// ./uarch-store -c cycle prover.steps
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "steplog.h"
+#include "stepstore.h"
+
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int pack(const char *path, const char *output, uint32 interval) {
+    double t0 = now();
+    struct StepLog log;
+    if (steplog_open(&log, path) != 0) {
+        perror(path);
+        return 2;
+    }
+    struct StepStoreWriter w;
+    if (stepstore_create(&w, output, interval) != 0) {
+        steplog_close(&log);
+        return 2;
+    }
+    const char *end = log.data + log.size;
+    struct StepRecord *rec = malloc(sizeof(struct StepRecord));
+    uint64 last_cycle = 0, outside = 0;
+    int ret = 0;
+    for (const char *p = steplog_find_step(log.data, end, log.data); p != NULL;
+         p = steplog_find_step(p, end, log.data)) {
+        uint64 cycle;
+        if (!steplog_step_cycle(p, end, &cycle) || (w.header.steps > 0 && cycle <= last_cycle)) {
+            fprintf(stderr, "%s: step %llu has no cycle counter above the previous one\n", path,
+                (unsigned long long)w.header.steps);
+            ret = 2;
+            break;
+        }
+        p = steplog_parse_step(p, end, rec);
+        if (p == NULL) {
+            fprintf(stderr, "%s: parse error after %llu steps\n", path, (unsigned long long)w.header.steps);
+            ret = 2;
+            break;
+        }
+        for (uint32 i = 0; i < rec->access_count; i++) {
+            uint32 word;
+            outside += rec->access_type[i] == STEPLOG_WRITE && !steplog_word(rec->access_paddr[i], &word);
+        }
+        stepstore_add(&w, cycle, rec);
+        last_cycle = cycle;
+    }
+    free(rec);
+    if (ret == 0 && w.header.steps == 0) {
+        fprintf(stderr, "%s: no steps\n", path);
+        ret = 2;
+    }
+    struct StepStoreHeader h = w.header;
+    if (stepstore_finish(&w) != 0 || ret != 0) {
+        remove(output);
+        steplog_close(&log);
+        return 2;
+    }
+    struct stat st;
+    stat(output, &st);
+    fprintf(stderr, "%s: %llu steps, %llu keyframes (every %u steps); %zu bytes -> %lld bytes (%.1fx) in %.3f s\n",
+        output, (unsigned long long)h.steps, (unsigned long long)h.keyframes, h.keyframe_interval, log.size,
+        (long long)st.st_size, (double)log.size / st.st_size, now() - t0);
+    if (outside > 0) {
+        fprintf(stderr, "%s: %llu writes outside the StandardRAM are kept in the access logs only\n", path,
+            (unsigned long long)outside);
+    }
+    steplog_close(&log);
+    return 0;
+}
+
+static int show(const char *path, uint64 cycle) {
+    struct StepStore s;
+    int ret = stepstore_open(&s, path);
+    if (ret != 0) {
+        if (ret > 0) {
+            fprintf(stderr, "%s: not a step store\n", path);
+        }
+        return 2;
+    }
+    int64 step = stepstore_find(&s, cycle);
+    if (step < 0) {
+        fprintf(stderr, "%s: no step with cycle %llu\n", path, (unsigned long long)cycle);
+        stepstore_close(&s);
+        return 1;
+    }
+    struct StepRecord *rec = malloc(sizeof(struct StepRecord));
+    uint64 *first = malloc(RAM_SIZE);
+    double t0 = now();
+    stepstore_step(&s, (uint64)step, rec);
+    double t = now() - t0;
+    stepstore_ram(&s, 0, first);
+    printf("cycle %llu: step %lld, keyframe step %llu, rebuilt in %.1f us\n", (unsigned long long)cycle,
+        (long long)step, (unsigned long long)s.index[step].keyframe, t * 1e6);
+    for (uint32 i = 0; i < RAM_SIZE / 8; i++) {
+        if (rec->ram[i] != first[i]) {
+            printf("  ram[%u] = 0x%016llx\n", i, (unsigned long long)rec->ram[i]);
+        }
+    }
+    for (uint32 i = 0; i < rec->access_count; i++) {
+        printf("  %s 0x%llx 0x%016llx\n", rec->access_type[i] == STEPLOG_WRITE ? "write" : "read ",
+            (unsigned long long)rec->access_paddr[i], (unsigned long long)rec->access_val[i]);
+    }
+    free(first);
+    free(rec);
+    stepstore_close(&s);
+    return 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-k interval] -o store steps.json\n"
+        "       %s -c cycle store\n", name, name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    long interval = 64;
+    bool lookup = false;
+    uint64 cycle = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:k:o:")) != -1) {
+        switch (opt) {
+        case 'c': lookup = true; cycle = strtoull(optarg, NULL, 0); break;
+        case 'k': interval = strtol(optarg, NULL, 0); break;
+        case 'o': output = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc || interval < 1 || interval > 0xffffffffL || lookup == (output != NULL)) {
+        usage(argv[0]);
+    }
+    return lookup ? show(argv[optind], cycle) : pack(argv[optind], output, (uint32)interval);
+}
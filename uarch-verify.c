@@ -0,0 +1,249 @@
+// Native pre-flight verifier for uarch step logs.
+//
+// Checks every step of a rv64ui-uarch-*-steps.json log with the same code the
+// circuit is built from: rv64i() on the access log, sanityCheckScheduled(),
+// the logged reads against circuit_ram, and circuit_ram plus the logged
+// writes against the next step's circuit_ram. The log is split into chunks
+// that a pool of threads parses and verifies in parallel.
+//
+// gcc -O2 -pthread -o uarch-verify uarch-verify.c
+// ./uarch-verify [-j threads] rv64ui-uarch-simple-steps.json
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "steplog.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define MAX_REPORTED_FAILURES 16
+
+struct Failure {
+    uint64 step;        // index within the chunk until the chunks are joined
+    const char *reason;
+    int code;
+};
+
+struct Chunk {
+    const char *start;
+    const char *end;
+    uint64 steps;
+    uint64 failures;
+    struct Failure failure[MAX_REPORTED_FAILURES];
+    bool parse_error;
+};
+
+struct Verifier {
+    struct StepLog log;
+    struct Chunk *chunks;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+};
+
+/// \brief Returns NULL if the step is valid, otherwise the reason and *code
+static const char *verify_step(const struct StepRecord *step, const uint64 *next_ram, int *code) {
+    *code = 0;
+    struct Input input;
+    if (!steplog_input(step, &input)) {
+        return "access log too long";
+    }
+    *code = rv64i(input);
+    if (*code != 0) {
+        return "rv64i rejected the access log";
+    }
+    if (sanityCheckScheduled(input) != 0) {
+        return "read after write";
+    }
+    uint64 after[RAM_SIZE / 8];
+    memcpy(after, step->ram, sizeof(after));
+    for (uint32 i = 0; i < step->access_count; i++) {
+        uint32 word;
+        if (!steplog_word(step->access_paddr[i], &word)) {
+            return "access outside the RAM page";
+        }
+        if (step->access_type[i] == STEPLOG_READ) {
+            if (step->ram[word] != step->access_val[i]) {
+                return "read value differs from circuit_ram";
+            }
+        } else {
+            after[word] = step->access_val[i];
+        }
+    }
+    if (next_ram != NULL && memcmp(after, next_ram, sizeof(after)) != 0) {
+        return "circuit_ram plus writes differs from next step";
+    }
+    return NULL;
+}
+
+static void record_failure(struct Chunk *chunk, uint64 step, const char *reason, int code) {
+    if (chunk->failures < MAX_REPORTED_FAILURES) {
+        struct Failure *f = &chunk->failure[chunk->failures];
+        f->step = step;
+        f->reason = reason;
+        f->code = code;
+    }
+    chunk->failures++;
+}
+
+/// \brief Returns the first step starting in [from, end) of the log, or NULL
+static const char *first_step(const struct StepLog *log, const char *from, const char *end) {
+    const char *logend = log->data + log->size;
+    const char *p = from;
+    for (;;) {
+        const char *s = steplog_find_step(p, logend, log->data);
+        if (s == NULL || s >= end) {
+            return NULL;
+        }
+        if (s >= from) {
+            return s;
+        }
+        p = s + 1;
+    }
+}
+
+/// \brief Returns the start of the step following the one that ended at p, or NULL at the end of the log
+static const char *next_step(const char *p, const char *end) {
+    p = steplog_ws(p, end);
+    if (p < end && *p == ',') {
+        p = steplog_ws(p + 1, end);
+    }
+    return p < end && *p == '{' ? p : NULL;
+}
+
+static void verify_chunk(const struct StepLog *log, struct Chunk *chunk) {
+    const char *logend = log->data + log->size;
+    struct StepRecord *cur = malloc(sizeof(struct StepRecord));
+    struct StepRecord *nxt = malloc(sizeof(struct StepRecord));
+    const char *p = first_step(log, chunk->start, chunk->end);
+    if (p != NULL) {
+        p = steplog_parse_step(p, logend, cur);
+        if (p == NULL) {
+            chunk->parse_error = true;
+        }
+    }
+    while (p != NULL) {
+        const char *s = next_step(p, logend);
+        const uint64 *next_ram = NULL;
+        if (s != NULL) {
+            // the first step of the next chunk is parsed here too, for the transition check
+            p = steplog_parse_step(s, logend, nxt);
+            if (p == NULL) {
+                chunk->parse_error = true;
+            } else {
+                next_ram = nxt->ram;
+            }
+        } else {
+            p = NULL;
+        }
+        int code;
+        const char *reason = verify_step(cur, next_ram, &code);
+        if (reason != NULL) {
+            record_failure(chunk, chunk->steps, reason, code);
+        }
+        chunk->steps++;
+        if (s == NULL || s >= chunk->end) {
+            break;
+        }
+        struct StepRecord *t = cur;
+        cur = nxt;
+        nxt = t;
+    }
+    free(cur);
+    free(nxt);
+}
+
+static void *worker(void *arg) {
+    struct Verifier *v = arg;
+    for (;;) {
+        size_t c = atomic_fetch_add(&v->next_chunk, 1);
+        if (c >= v->chunk_count) {
+            return NULL;
+        }
+        verify_chunk(&v->log, &v->chunks[c]);
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "j:")) != -1) {
+        if (opt == 'j') {
+            threads = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-j threads] steps.json\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind + 1 != argc || threads < 1) {
+        fprintf(stderr, "usage: %s [-j threads] steps.json\n", argv[0]);
+        return 2;
+    }
+    struct Verifier v;
+    if (steplog_open(&v.log, argv[optind]) != 0) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    // several chunks per thread so that uneven chunks still balance
+    size_t chunk_size = 64 << 20;
+    v.chunk_count = v.log.size / chunk_size + 1;
+    if (v.chunk_count < (size_t)threads * 4) {
+        v.chunk_count = (size_t)threads * 4;
+    }
+    chunk_size = v.log.size / v.chunk_count + 1;
+    v.chunks = calloc(v.chunk_count, sizeof(struct Chunk));
+    for (size_t c = 0; c < v.chunk_count; c++) {
+        size_t start = c * chunk_size;
+        size_t end = start + chunk_size;
+        v.chunks[c].start = v.log.data + (start < v.log.size ? start : v.log.size);
+        v.chunks[c].end = v.log.data + (end < v.log.size ? end : v.log.size);
+    }
+    atomic_init(&v.next_chunk, 0);
+
+    double t0 = now();
+    pthread_t *pool = malloc(sizeof(pthread_t) * threads);
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&pool[t], NULL, worker, &v);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    double elapsed = now() - t0;
+
+    uint64 steps = 0, failures = 0;
+    bool parse_error = false;
+    for (size_t c = 0; c < v.chunk_count; c++) {
+        struct Chunk *chunk = &v.chunks[c];
+        for (uint64 f = 0; f < chunk->failures && f < MAX_REPORTED_FAILURES; f++) {
+            if (failures + f < MAX_REPORTED_FAILURES) {
+                struct Failure *fail = &chunk->failure[f];
+                printf("step %llu: %s", (unsigned long long)(steps + fail->step), fail->reason);
+                if (fail->code != 0) {
+                    printf(" (%d)", fail->code);
+                }
+                printf("\n");
+            }
+        }
+        if (chunk->parse_error) {
+            printf("parse error after step %llu\n", (unsigned long long)(steps + chunk->steps));
+            parse_error = true;
+        }
+        steps += chunk->steps;
+        failures += chunk->failures;
+    }
+    printf("%llu steps, %llu failed, %.3f s, %.0f steps/s, %.1f MB/s (%d threads)\n",
+        (unsigned long long)steps, (unsigned long long)failures, elapsed,
+        steps / elapsed, v.log.size / elapsed / 1e6, threads);
+
+    free(pool);
+    free(v.chunks);
+    steplog_close(&v.log);
+    return failures == 0 && !parse_error && steps > 0 ? 0 : 1;
+}
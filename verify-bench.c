@@ -0,0 +1,268 @@
+// Checks the native verification of verify-native.h against mpc_main and times both.
+//
+// The inputs are uarch-bisect -o files or mpc_main test vectors (spec2vec,
+// uarch-bisect -V) of a build with the same -D flags. Every input is checked
+// as it is and in -m mutated copies (1000 by default): a bit flipped in a
+// field other than the RAMs, in ram or ram_disagree, or in the same word of a
+// RAM and of the snapshot it is compared with, so that the snapshots still
+// match and the step check decides; those words are the ones of the access
+// log half of the time. verify_native, verify_native_bytes and mpc_main have
+// to return the same on every copy, and a test vector its recorded
+// return_value. Then verify_native_bytes and mpc_main are timed on every
+// input. mpc_main passes its input down by value, so the tool runs on a
+// thread with a stack for that.
+//
+// gcc -O2 -pthread -o verify-bench verify-bench.c
+// ./verify-bench [-m mutations] input.bin|inputs.vec...
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "input-layout.h"
+#include "testvec.h"
+#include "verify-native.h"
+
+#include <pthread.h>
+#include <time.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64 rng = 0x9e3779b97f4a7c15ull;
+
+static uint64 next_random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/// \brief Byte offset and size of a field in the layout bytes; false if there is none
+static bool layout_field(const char *name, size_t *offset, size_t *size) {
+    size_t at = 0;
+    for (uint32 i = 0; i < mpc_input_layout.field_count; i++) {
+        const struct LayoutField *f = &mpc_input_layout.fields[i];
+        size_t n = (size_t)f->elem_bytes * f->count;
+        if (strcmp(f->name, name) == 0) {
+            *offset = at;
+            *size = n;
+            return true;
+        }
+        at += n;
+    }
+    return false;
+}
+
+static bool is_ram_field(const char *name) {
+    return strcmp(name, "ram") == 0 || strcmp(name, "ram_disagree") == 0 || strcmp(name, "prover_bisection_RAM") == 0;
+}
+
+static void flip(uint8 *bytes, size_t offset, size_t size) {
+    uint64 bit = next_random() % (size * 8);
+    bytes[offset + bit / 8] ^= 1 << (bit % 8);
+}
+
+/// \brief Flips a random bit of a copy of the input; see the header comment
+static void mutate(uint8 *bytes) {
+    uint32 kind = next_random() % 3;
+#ifndef RV64I_MERKLE
+    size_t ram = 0, ram_disagree = 0, ram_bytes;
+    layout_field("ram", &ram, &ram_bytes);
+    layout_field("ram_disagree", &ram_disagree, &ram_bytes);
+    if (kind == 1) {
+        flip(bytes, next_random() & 1 ? ram : ram_disagree, sizeof(StandardRAM));
+        return;
+    }
+    if (kind == 2) {
+        struct VerifyView v;
+        verify_view_bytes(&v, bytes);
+        uint64 word = next_random() % (RAM_SIZE / 8);
+        if (next_random() & 1) {
+            uint64 off = ramOffset(v.step.access_paddr[next_random() % ACCESS_LOG_SIZE]) / 8;
+            word = off < RAM_SIZE / 8 ? off : word;
+        }
+        uint64 mask = 1ull << (next_random() % 64);
+        uint32 which = 1 + next_random() % 3;     // the agreed pair, the disagreed one or both
+        if (which & 1) {
+            ((uint64 *)(bytes + ram))[word] ^= mask;
+            ((uint64 *)(bytes + ((const uint8 *)v.agree - bytes)))[word] ^= mask;
+        }
+        if (which & 2) {
+            ((uint64 *)(bytes + ram_disagree))[word] ^= mask;
+            ((uint64 *)(bytes + ((const uint8 *)v.disagree - bytes)))[word] ^= mask;
+        }
+        return;
+    }
+#endif
+    (void)kind;
+    const struct LayoutField *f;
+    do {
+        f = &mpc_input_layout.fields[next_random() % mpc_input_layout.field_count];
+    } while (is_ram_field(f->name));
+    size_t offset = 0, n = 1;
+    layout_field(f->name, &offset, &n);
+    flip(bytes, offset, n);
+}
+
+struct Bench {
+    char **paths;
+    int count;
+    uint64 mutations;
+    int ret;
+};
+
+/// \brief Checks one input and its mutations; returns the number of disagreements
+static uint64 check(const char *name, const uint8 *input, int64 expected, uint64 mutations, MpcInput *in,
+    uint8 *copy, uint64 *accepted) {
+    size_t size = layout_size(&mpc_input_layout);
+    uint64 wrong = 0;
+    for (uint64 m = 0; m <= mutations; m++) {
+        memcpy(copy, input, size);
+        if (m > 0) {
+            mutate(copy);
+        }
+        layout_unpack(&mpc_input_layout, copy, in);
+        int ref = mpc_main(*in);
+        int native = verify_native(in);
+        int bytes = verify_native_bytes(copy);
+        *accepted += ref == 0;
+        if (native != ref || bytes != ref || (m == 0 && expected >= 0 && ref != expected)) {
+            if (wrong++ < 5) {
+                fprintf(stderr, "%s, mutation %llu: mpc_main %d, verify_native %d, verify_native_bytes %d%s\n",
+                    name, (unsigned long long)m, ref, native, bytes,
+                    m == 0 && expected >= 0 && ref != expected ? ", not the recorded return_value" : "");
+            }
+        }
+    }
+    return wrong;
+}
+
+static void bench(const char *name, const uint8 *input, MpcInput *in) {
+    layout_unpack(&mpc_input_layout, input, in);
+    int ret = verify_native_bytes(input);
+    uint64 reps = 1;
+    double t, t0;
+    do {
+        reps *= 2;
+        t0 = now();
+        for (uint64 i = 0; i < reps; i++) {
+            ret |= verify_native_bytes(input);
+            __asm__ volatile("" : : : "memory");
+        }
+        t = now() - t0;
+    } while (t < 0.1);
+    double native = t / reps;
+    reps = 1;
+    do {
+        reps *= 2;
+        t0 = now();
+        for (uint64 i = 0; i < reps; i++) {
+            ret |= mpc_main(*in);
+            __asm__ volatile("" : : : "memory");
+        }
+        t = now() - t0;
+    } while (t < 0.1);
+    double ref = t / reps;
+    printf("%-40s returns %d: verify_native_bytes %8.0f ns, mpc_main %8.0f ns (%.0fx)\n", name, ret,
+        native * 1e9, ref * 1e9, ref / native);
+}
+
+/// \brief Checks and times every input file, a raw input or test vectors
+static void *run(void *arg) {
+    struct Bench *b = arg;
+    size_t size = layout_size(&mpc_input_layout);
+    MpcInput *in = malloc(sizeof(MpcInput));
+    uint8 *copy = aligned_alloc(64, (size + 63) / 64 * 64);
+    uint8 *raw = aligned_alloc(64, (size + 63) / 64 * 64);
+    uint64 inputs = 0, checked = 0, accepted = 0, wrong = 0;
+    for (int i = 0; i < b->count; i++) {
+        const char *path = b->paths[i];
+        struct TestVec tv;
+        int ret = testvec_open(&tv, path);
+        if (ret < 0) {
+            b->ret = 2;
+            continue;
+        }
+        if (ret == 0) {
+            if (!testvec_matches(&tv, &mpc_input_layout)) {
+                fprintf(stderr, "%s: not mpc_main test vectors of this build\n", path);
+                testvec_close(&tv);
+                b->ret = 2;
+                continue;
+            }
+            for (uint64 r = 0; r < tv.header->count; r++) {
+                const struct TestVecRecord *rec = testvec_record(&tv, r);
+                char name[sizeof(rec->name) + 1];
+                snprintf(name, sizeof(name), "%s", rec->name);
+                wrong += check(name, testvec_input(&tv, r), rec->expected, b->mutations, in, copy, &accepted);
+                bench(name, testvec_input(&tv, r), in);
+                checked += b->mutations + 1;
+                inputs++;
+            }
+            testvec_close(&tv);
+            continue;
+        }
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            perror(path);
+            b->ret = 2;
+            continue;
+        }
+        size_t got = fread(raw, 1, size, f);
+        bool longer = fgetc(f) != EOF;
+        fclose(f);
+        if (got != size || longer) {
+            fprintf(stderr, "%s: not %zu bytes, the mpc_main input of this build\n", path, size);
+            b->ret = 2;
+            continue;
+        }
+        wrong += check(path, raw, -1, b->mutations, in, copy, &accepted);
+        bench(path, raw, in);
+        checked += b->mutations + 1;
+        inputs++;
+    }
+    fprintf(stderr, "%llu inputs, %llu checked, %llu accepted by mpc_main, %llu disagreements\n",
+        (unsigned long long)inputs, (unsigned long long)checked, (unsigned long long)accepted,
+        (unsigned long long)wrong);
+    if (wrong > 0) {
+        b->ret = 1;
+    }
+    free(raw);
+    free(copy);
+    free(in);
+    return NULL;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m mutations] input.bin|inputs.vec...\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    struct Bench b = { NULL, 0, 1000, 0 };
+    int opt;
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        switch (opt) {
+        case 'm': b.mutations = strtoull(optarg, NULL, 0); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+    }
+    b.paths = argv + optind;
+    b.count = argc - optind;
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 16 * sizeof(MpcInput) + (1 << 20));
+    if (pthread_create(&thread, &attr, run, &b) != 0) {
+        fprintf(stderr, "cannot start mpc_main\n");
+        return 2;
+    }
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    return b.ret;
+}
@@ -0,0 +1,215 @@
+// Native verification of the mpc_main input, without copying it.
+//
+// Include after input-layout.h. mpc_main takes its input by value and passes
+// it down by value, the way the circuit compiler wants it: natively that is a
+// copy of the whole BisectInput (270 KB with the default schedule) into
+// verify_bisection, another into run_step and access_and_compare_sparse, and
+// one per snapshot compare. verify_native returns what mpc_main returns but
+// reads the input in place: the two RAMs and the two prover snapshots the
+// bisection ends on through pointers, only the access log (a few hundred
+// bytes) into a struct Input for rv64i. verify_native_bytes does the same on
+// the input in the layout of input-layout.h, e.g. an uarch-bisect -o file or a
+// test vector record mapped in place: the StandardRAM fields lead the struct,
+// so they are at the same offsets there and are read where they lie.
+//
+// The step check is access_and_compare_sparse, sanityCheckScheduled and rv64i
+// of run_step. rv64i and sanityCheckScheduled are the circuit's own; the
+// sparse compare is redone on pointers with the same result, the touched words
+// in a bitmap and the untouched ones compared 64 at a time. verify-bench
+// checks every entry point against mpc_main.
+
+#ifndef VERIFY_NATIVE_H
+#define VERIFY_NATIVE_H
+
+#ifndef RV64I_MERKLE
+struct VerifyView {
+    const uint64 *ram;
+    const uint64 *ram_disagree;
+    const uint64 *agree;        // the prover snapshot ram has to equal
+    const uint64 *disagree;     // the one ram_disagree has to equal
+    struct Input step;          // access log, as rv64i takes them
+};
+
+/// \brief The access log part of access_and_compare_sparse: every read matches
+/// ram and the last write to a word ram_disagree; marks the written words in touched
+static inline bool verify_accesses_native(const uint64 *ram, const uint64 *ram_disagree, const struct Input *step,
+    uint64 *touched) {
+    static const uint64 fixed_word[SPARSE_FIXED_SLOTS] = { UCYCLE / 8, UHALT / 8, UPC / 8 };
+    uint64 word[ACCESS_LOG_SIZE];
+    bool write[ACCESS_LOG_SIZE];
+    bool ended = false;
+
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+        uint8 tag = step->access_readWriteEnd[i];
+        ended = ended || tag == 2;
+        bool read = !ended && tag == 0;
+        write[i] = !ended && i >= SANITY_FIRST_WRITE_SLOT && tag == 1;
+        uint64 off = ramOffset(step->access_paddr[i]) / 8;
+        if ((read || write[i]) && off >= RAM_SIZE / 8) {
+            return false;
+        }
+        word[i] = i < SPARSE_FIXED_SLOTS ? fixed_word[i] : off % (RAM_SIZE / 8);
+        if (read && ram[word[i]] != step->access_val[i]) {
+            return false;
+        }
+    }
+    // the last write to a word is the first one seen from the end
+    for (int i = ACCESS_LOG_SIZE - 1; i >= SANITY_FIRST_WRITE_SLOT; i--) {
+        uint64 bit = 1ull << (word[i] % 64);
+        if (write[i] && (touched[word[i] / 64] & bit) == 0) {
+            touched[word[i] / 64] |= bit;
+            if (ram_disagree[word[i]] != step->access_val[i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// \brief The untouched words of access_and_compare_sparse: ram and ram_disagree
+/// are equal outside the words in touched, compared 64 words at a time
+static inline bool verify_untouched_native(const uint64 *ram, const uint64 *ram_disagree, const uint64 *touched) {
+    for (int j = 0; j < RAM_SIZE / 8; j += 64) {
+        uint64 mask = touched[j / 64];
+        if (mask == 0) {
+            if (memcmp(ram + j, ram_disagree + j, 64 * 8) != 0) {
+                return false;
+            }
+            continue;
+        }
+        for (int k = 0; k < 64; k++) {
+            if ((mask >> k & 1) == 0 && ram[j + k] != ram_disagree[j + k]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// \brief verify_bisection's result on the view: 0 if the step from the agreed
+/// to the disagreed snapshot is the logged one, 1 otherwise
+static inline int verify_view(const struct VerifyView *v) {
+    uint64 touched[RAM_SIZE / 8 / 64] = { 0 };
+    bool ok = memcmp(v->ram, v->agree, sizeof(StandardRAM)) == 0 &&
+        memcmp(v->ram_disagree, v->disagree, sizeof(StandardRAM)) == 0 &&
+        verify_accesses_native(v->ram, v->ram_disagree, &v->step, touched) &&
+        verify_untouched_native(v->ram, v->ram_disagree, touched) &&
+        sanityCheckScheduled(v->step) == 0 && rv64i(v->step) == 0;
+    return ok ? 0 : 1;
+}
+
+/// \brief Points the view at the snapshots the answers select; snapshots is
+/// prover_bisection_RAM of the input
+static inline void verify_view_snapshots(struct VerifyView *v, const uint64 *snapshots, const uint8 *answers) {
+    int agree_ram, disagree_ram;
+#ifdef BISECTION_SCHEDULE_PUBLIC
+    (void)answers;
+    agree_ram = AGREE_SNAPSHOT;
+    disagree_ram = DISAGREE_SNAPSHOT;
+#else
+    bisectionSnapshots(answers, &agree_ram, &disagree_ram);
+#endif
+    v->agree = snapshots + (size_t)agree_ram * (RAM_SIZE / 8);
+    v->disagree = snapshots + (size_t)disagree_ram * (RAM_SIZE / 8);
+}
+
+#ifdef RV64I_PACKED_INPUT
+static inline void verify_unpack_slots(struct Input *step, const uint16 *slots) {
+    for (int i = 0; i < ACCESS_LOG_SIZE; i++) {
+        step->access_paddr[i] = unpackPaddr(slots[i]);
+        step->access_readWriteEnd[i] = unpackTag(slots[i]);
+    }
+}
+
+static inline void verify_unpack_answers(uint8 *answers, uint32 packed) {
+    for (int j = 0; j < BISECTION_STEPS; j++) {
+        answers[j] = (packed >> (j * DISSECTION_ANSWER_BITS)) & ((1 << DISSECTION_ANSWER_BITS) - 1);
+    }
+}
+#endif
+
+/// \brief The view of an input struct, pointing into it
+static inline void verify_view_init(struct VerifyView *v, const MpcInput *in) {
+    uint8 answers[BISECTION_STEPS] = { 0 };
+    v->ram = in->ram;
+    v->ram_disagree = in->ram_disagree;
+#ifdef RV64I_PACKED_INPUT
+    verify_unpack_slots(&v->step, in->access_slot);
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    verify_unpack_answers(answers, in->verifier_bisections);
+#endif
+#else
+    memcpy(v->step.access_paddr, in->access_paddr, sizeof(in->access_paddr));
+    memcpy(v->step.access_readWriteEnd, in->access_readWriteEnd, sizeof(in->access_readWriteEnd));
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    memcpy(answers, in->verifier_bisections, sizeof(answers));
+#endif
+#endif
+    memcpy(v->step.access_val, in->access_val, sizeof(in->access_val));
+    verify_view_snapshots(v, in->prover_bisection_RAM[0], answers);
+}
+
+// the next field of the layout bytes at p into dst
+#define VERIFY_TAKE(dst, p) (memcpy(&(dst), p, sizeof(dst)), p += sizeof(dst))
+
+/// \brief The view of an input in the layout of input-layout.h, pointing into
+/// bytes, which have to be 8-byte aligned
+static inline void verify_view_bytes(struct VerifyView *v, const uint8 *bytes) {
+    uint8 answers[BISECTION_STEPS] = { 0 };
+    const MpcInput *in = NULL;  // for the field sizes only
+    const uint8 *p = bytes + offsetof(MpcInput, prover_bisection_RAM) + sizeof(in->prover_bisection_RAM);
+    v->ram = (const uint64 *)(bytes + offsetof(MpcInput, ram));
+    v->ram_disagree = (const uint64 *)(bytes + offsetof(MpcInput, ram_disagree));
+#ifdef RV64I_PACKED_INPUT
+    uint16 slots[ACCESS_LOG_SIZE];
+    VERIFY_TAKE(slots, p);
+    VERIFY_TAKE(v->step.access_val, p);
+    verify_unpack_slots(&v->step, slots);
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    uint32 packed;
+    VERIFY_TAKE(packed, p);
+    verify_unpack_answers(answers, packed);
+#endif
+#else
+    VERIFY_TAKE(v->step.access_paddr, p);
+    VERIFY_TAKE(v->step.access_val, p);
+    VERIFY_TAKE(v->step.access_readWriteEnd, p);
+#ifndef BISECTION_SCHEDULE_PUBLIC
+    VERIFY_TAKE(answers, p);
+#endif
+#endif
+    (void)p;
+    verify_view_snapshots(v, (const uint64 *)(bytes + offsetof(MpcInput, prover_bisection_RAM)), answers);
+}
+
+#undef VERIFY_TAKE
+
+/// \brief mpc_main(*in)
+static inline int verify_native(const MpcInput *in) {
+    struct VerifyView v;
+    verify_view_init(&v, in);
+    return verify_view(&v);
+}
+
+/// \brief mpc_main on the input in the layout of input-layout.h, read in place
+/// from 8-byte aligned bytes
+static inline int verify_native_bytes(const uint8 *bytes) {
+    struct VerifyView v;
+    verify_view_bytes(&v, bytes);
+    return verify_view(&v);
+}
+#else
+// The Merkle input is a few kilobytes and its check is hashing, so it is
+// passed on as it is.
+static inline int verify_native(const MpcInput *in) {
+    return verify_bisection_merkle(*in);
+}
+
+static inline int verify_native_bytes(const uint8 *bytes) {
+    MpcInput in;
+    layout_unpack(&mpc_input_layout, bytes, &in);
+    return verify_bisection_merkle(in);
+}
+#endif
+
+#endif
@@ -0,0 +1,628 @@
+// Verifier daemon: evaluates a Bristol circuit for requests on a Unix socket.
+//
+// The circuit is loaded once, a text circuit parsed or a binary one (-w
+// converts, bristol.h) mapped in place, and the daemon listens on a Unix
+// stream socket. A request is a struct VerifyRequest followed by the circuit
+// input, the input bits LSB first: for the mpc_main or rv64i circuit of a
+// build the bytes of the input-layout.h layout (a BisectInput, PackedBisectInput
+// or MerkleBisectInput, or an Input), as uarch-bisect -o files and test vector
+// records hold them. The reply is a struct VerifyReply with the circuit's
+// return_value, its outputs LSB first and sign extended, or an error status.
+// A connection may send several requests before reading the replies; they
+// come back in the order the passes finish, told apart by their id.
+//
+// Every connection has a reader thread that queues its requests. The -j
+// evaluator threads take up to 64 queued requests each, of any connections,
+// into the lanes of one bit-sliced pass over the gates (bristol_eval_sliced),
+// so concurrent requests share a pass; a pass starts as soon as a request is
+// queued and takes whatever has arrived, so a lone request does not wait for
+// others. Every -r seconds (10 by default) and at SIGINT or SIGTERM the daemon
+// prints the requests, the lanes per pass and the p50/p99 latency from the
+// last byte of a request read to its reply written.
+//
+// -C is a client for testing and load: it sends the inputs of test vector
+// files (spec2vec, uarch-bisect -V) or raw input files round robin over -c
+// connections, -d requests in flight on each, -n requests in all, checks the
+// replies against the recorded return_values and reports the requests per
+// second and the p50/p99 latency it sees.
+//
+// gcc -O2 -march=native -pthread -o verifyd verifyd.c
+// ./verifyd -w circuit.bin circuit.txt
+// ./verifyd [-j threads] [-s socket] [-r seconds] circuit.txt|circuit.bin
+// ./verifyd -C [-s socket] [-c connections] [-d depth] [-n requests] inputs.vec|input.bin...
+
+#define __CPROVER_assume(x) do { } while (0)
+#include "rv64i.c"
+#include "input-layout.h"
+#include "bristol.h"
+#include "testvec.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+#define LANES 64
+#define VERIFYD_MAGIC 0x31445652u       // "RVD1"
+#define VERIFYD_SOCKET "verifyd.sock"
+#define VERIFYD_QUEUE 4096
+
+#define VERIFYD_OK 0
+#define VERIFYD_BAD_REQUEST 1           // wrong magic or input size; the connection is closed
+
+struct VerifyRequest {
+    uint32 magic;
+    uint32 bytes;                       // of the input that follows, (circuit inputs + 7) / 8
+    uint64 id;                          // echoed in the reply
+};
+
+struct VerifyReply {
+    uint64 id;
+    int64 result;                       // the circuit's return_value
+    uint32 status;
+    uint32 reserved;
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// \brief Reads n bytes; returns 1, 0 at end of file before the first byte, or -1
+static int read_full(int fd, void *buf, size_t n) {
+    for (size_t got = 0; got < n;) {
+        ssize_t r = read(fd, (uint8 *)buf + got, n - got);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return r == 0 && got == 0 ? 0 : -1;
+        }
+        got += r;
+    }
+    return 1;
+}
+
+/// \brief Writes the iovecs; returns 0 or -1
+static int write_full(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = count };
+        ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return -1;
+        }
+        for (; count > 0 && (size_t)w >= iov->iov_len; iov++, count--) {
+            w -= iov->iov_len;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8 *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    return 0;
+}
+
+// Latency histogram: 64 buckets per power of two of nanoseconds, so a
+// percentile is off by less than 1/64 of its value.
+#define HIST_SUB 64
+#define HIST_BUCKETS ((64 - 5) * HIST_SUB)
+
+struct Histogram {
+    uint64 count[HIST_BUCKETS];
+    uint64 total;
+    uint64 max;
+};
+
+static inline uint32 hist_bucket(uint64 ns) {
+    if (ns < HIST_SUB) {
+        return (uint32)ns;
+    }
+    int e = 63 - __builtin_clzll(ns);
+    return (e - 5) * HIST_SUB + ((ns >> (e - 6)) & (HIST_SUB - 1));
+}
+
+static inline uint64 hist_value(uint32 b) {
+    if (b < HIST_SUB) {
+        return b;
+    }
+    int e = b / HIST_SUB + 5;
+    return (uint64)(HIST_SUB + b % HIST_SUB) << (e - 6);
+}
+
+static void hist_add(struct Histogram *h, double seconds) {
+    uint64 ns = (uint64)(seconds * 1e9);
+    h->count[hist_bucket(ns)]++;
+    h->total++;
+    h->max = ns > h->max ? ns : h->max;
+}
+
+/// \brief The latency in microseconds below which a fraction q of the requests are
+static double hist_percentile(const struct Histogram *h, double q) {
+    uint64 rank = (uint64)(q * h->total), seen = 0;
+    for (uint32 b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->count[b];
+        if (seen > rank) {
+            return hist_value(b) * 1e-3;
+        }
+    }
+    return h->max * 1e-3;
+}
+
+struct Conn {
+    int fd;
+    pthread_mutex_t write_lock;
+    atomic_int refs;                    // the reader and every queued request
+};
+
+struct Request {
+    struct Conn *conn;
+    uint64 id;
+    double received;
+    uint64 *bits;                       // the input, padded to whole 64-bit words
+};
+
+struct Daemon {
+    struct BristolCircuit circuit;
+    uint32 input_bytes;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    struct Request queue[VERIFYD_QUEUE];
+    size_t head, queued;
+    pthread_mutex_t stats_lock;
+    struct Histogram window, all;       // since the last report, since the start
+    uint64 passes[2], lanes[2];         // window, all
+    double start[2];
+};
+
+static volatile sig_atomic_t stopping;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static void conn_release(struct Conn *conn) {
+    if (atomic_fetch_sub(&conn->refs, 1) == 1) {
+        close(conn->fd);
+        pthread_mutex_destroy(&conn->write_lock);
+        free(conn);
+    }
+}
+
+static void reply(struct Conn *conn, uint64 id, int64 result, uint32 status) {
+    struct VerifyReply r = { id, result, status, 0 };
+    struct iovec iov = { &r, sizeof(r) };
+    pthread_mutex_lock(&conn->write_lock);
+    write_full(conn->fd, &iov, 1);      // a client that is gone gets no reply
+    pthread_mutex_unlock(&conn->write_lock);
+}
+
+struct Reader {
+    struct Daemon *d;
+    struct Conn *conn;
+};
+
+static void *reader(void *arg) {
+    struct Reader *rd = arg;
+    struct Daemon *d = rd->d;
+    struct Conn *conn = rd->conn;
+    free(rd);
+    size_t words = (d->input_bytes + 7) / 8;
+    for (;;) {
+        struct VerifyRequest req;
+        if (read_full(conn->fd, &req, sizeof(req)) <= 0) {
+            break;
+        }
+        if (req.magic != VERIFYD_MAGIC || req.bytes != d->input_bytes) {
+            reply(conn, req.id, 0, VERIFYD_BAD_REQUEST);
+            break;
+        }
+        uint64 *bits = malloc(words * 8);
+        bits[words - 1] = 0;
+        if (read_full(conn->fd, bits, d->input_bytes) <= 0) {
+            free(bits);
+            break;
+        }
+        atomic_fetch_add(&conn->refs, 1);
+        pthread_mutex_lock(&d->lock);
+        while (d->queued == VERIFYD_QUEUE) {
+            pthread_cond_wait(&d->space, &d->lock);
+        }
+        d->queue[(d->head + d->queued++) % VERIFYD_QUEUE] = (struct Request){ conn, req.id, now(), bits };
+        pthread_cond_signal(&d->ready);
+        pthread_mutex_unlock(&d->lock);
+    }
+    conn_release(conn);
+    return NULL;
+}
+
+static void *evaluator(void *arg) {
+    struct Daemon *d = arg;
+    const struct BristolCircuit *c = &d->circuit;
+    uint64 *w = malloc((size_t)c->wires * sizeof(uint64));
+    struct Request batch[LANES];
+    for (;;) {
+        pthread_mutex_lock(&d->lock);
+        while (d->queued == 0) {
+            pthread_cond_wait(&d->ready, &d->lock);
+        }
+        size_t lanes = d->queued < LANES ? d->queued : LANES;
+        for (size_t k = 0; k < lanes; k++) {
+            batch[k] = d->queue[d->head];
+            d->head = (d->head + 1) % VERIFYD_QUEUE;
+        }
+        d->queued -= lanes;
+        pthread_cond_broadcast(&d->space);
+        pthread_mutex_unlock(&d->lock);
+
+        memset(w, 0, (size_t)c->inputs * sizeof(uint64));
+        for (size_t k = 0; k < lanes; k++) {
+            bristol_set_lane(c, w, k, (const uint8 *)batch[k].bits);
+        }
+        bristol_eval_sliced(c, w);
+        double done[LANES];
+        for (size_t k = 0; k < lanes; k++) {
+            reply(batch[k].conn, batch[k].id, bristol_lane_output(c, w, k), VERIFYD_OK);
+            done[k] = now();
+            free(batch[k].bits);
+            conn_release(batch[k].conn);
+        }
+        pthread_mutex_lock(&d->stats_lock);
+        for (size_t k = 0; k < lanes; k++) {
+            hist_add(&d->window, done[k] - batch[k].received);
+            hist_add(&d->all, done[k] - batch[k].received);
+        }
+        for (int i = 0; i < 2; i++) {
+            d->passes[i]++;
+            d->lanes[i] += lanes;
+        }
+        pthread_mutex_unlock(&d->stats_lock);
+    }
+    return NULL;
+}
+
+static double report_interval = 10;
+
+static void report(struct Daemon *d, bool final) {
+    pthread_mutex_lock(&d->stats_lock);
+    const struct Histogram *h = final ? &d->all : &d->window;
+    double t = now() - d->start[final];
+    if (h->total > 0) {
+        fprintf(stderr, "%s%llu requests (%.0f/s), %.1f lanes per pass; latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            final ? "total: " : "", (unsigned long long)h->total, h->total / t,
+            (double)d->lanes[final] / d->passes[final], hist_percentile(h, 0.50), hist_percentile(h, 0.99),
+            h->max * 1e-3);
+    }
+    memset(&d->window, 0, sizeof(d->window));
+    d->passes[0] = d->lanes[0] = 0;
+    d->start[0] = now();
+    pthread_mutex_unlock(&d->stats_lock);
+}
+
+static void *reporter(void *arg) {
+    struct Daemon *d = arg;
+    struct timespec ts = { (time_t)report_interval, (long)((report_interval - (time_t)report_interval) * 1e9) };
+    for (;;) {
+        nanosleep(&ts, NULL);
+        report(d, false);
+    }
+    return NULL;
+}
+
+static int serve(const char *path, const char *socket_path, int threads) {
+    struct Daemon *d = calloc(1, sizeof(struct Daemon));
+    double t0 = now();
+    if (bristol_load(&d->circuit, path) != 0) {
+        return 2;
+    }
+    const struct BristolCircuit *c = &d->circuit;
+    if (c->outputs == 0) {
+        fprintf(stderr, "%s has no outputs\n", path);
+        return 2;
+    }
+    d->input_bytes = (c->inputs + 7) / 8;
+    const char *takes = layout_size(&mpc_input_layout) * 8 == c->inputs ? "the mpc_main input of this build" :
+        layout_size(&step_input_layout) * 8 == c->inputs ? "the rv64i input of this build" : "raw input bits";
+    fprintf(stderr, "%s: %u gates, %u inputs (%s), loaded in %.3f s\n", path, c->gates, c->inputs, takes,
+        now() - t0);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", socket_path);
+        return 2;
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0) {
+        perror(socket_path);
+        return 2;
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->ready, NULL);
+    pthread_cond_init(&d->space, NULL);
+    pthread_mutex_init(&d->stats_lock, NULL);
+    d->start[0] = d->start[1] = now();
+    // the signals stay blocked in every thread and reach the main thread only
+    // while it waits for a connection, so the wait ends on them
+    sigset_t signals, waiting;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &waiting);
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    pthread_t thread;
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&thread, NULL, evaluator, d);
+    }
+    pthread_create(&thread, NULL, reporter, d);
+    fprintf(stderr, "listening on %s, %d evaluator threads\n", socket_path, threads);
+
+    while (!stopping) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        if (pselect(fd + 1, &readable, NULL, NULL, NULL, &waiting) <= 0) {
+            continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            perror("accept");
+            continue;
+        }
+        struct Conn *conn = malloc(sizeof(struct Conn));
+        conn->fd = client;
+        pthread_mutex_init(&conn->write_lock, NULL);
+        atomic_init(&conn->refs, 1);
+        struct Reader *rd = malloc(sizeof(struct Reader));
+        *rd = (struct Reader){ d, conn };
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, reader, rd) != 0) {
+            close(client);
+            free(conn);
+            free(rd);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    close(fd);
+    unlink(socket_path);
+    report(d, true);
+    return 0;
+}
+
+// client
+
+struct Source {
+    const uint8 *bits;
+    uint32 bytes;
+    int64 expected;
+    bool has_expected;
+};
+
+struct Client {
+    const char *socket_path;
+    struct Source *sources;
+    size_t source_count;
+    uint64 requests;
+    uint32 depth;
+    atomic_uint_fast64_t next;
+    pthread_mutex_t lock;
+    struct Histogram latency;
+    uint64 wrong, errors;
+};
+
+struct InFlight {
+    uint64 id;
+    double sent;
+    const struct Source *source;
+};
+
+static void *client_thread(void *arg) {
+    struct Client *cl = arg;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cl->socket_path);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror(cl->socket_path);
+        pthread_mutex_lock(&cl->lock);
+        cl->errors++;
+        pthread_mutex_unlock(&cl->lock);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    struct InFlight *flight = calloc(cl->depth, sizeof(struct InFlight));
+    struct Histogram *h = calloc(1, sizeof(struct Histogram));
+    uint32 pending = 0;
+    uint64 wrong = 0, errors = 0;
+    bool more = true;
+    while (more || pending > 0) {
+        while (more && pending < cl->depth) {
+            uint64 i = atomic_fetch_add(&cl->next, 1);
+            if (i >= cl->requests) {
+                more = false;
+                break;
+            }
+            const struct Source *s = &cl->sources[i % cl->source_count];
+            struct VerifyRequest req = { VERIFYD_MAGIC, s->bytes, i };
+            struct iovec iov[2] = { { &req, sizeof(req) }, { (void *)s->bits, s->bytes } };
+            flight[pending++] = (struct InFlight){ i, now(), s };
+            if (write_full(fd, iov, 2) != 0) {
+                errors++;
+                more = false;
+                pending = 0;
+            }
+        }
+        if (pending == 0) {
+            break;
+        }
+        struct VerifyReply r;
+        if (read_full(fd, &r, sizeof(r)) <= 0) {
+            errors += pending;
+            break;
+        }
+        double t = now();
+        uint32 j = 0;
+        while (j < pending && flight[j].id != r.id) {
+            j++;
+        }
+        if (j == pending) {
+            errors++;
+            continue;
+        }
+        hist_add(h, t - flight[j].sent);
+        if (r.status != VERIFYD_OK) {
+            errors++;
+        } else if (flight[j].source->has_expected && r.result != flight[j].source->expected) {
+            wrong++;
+        }
+        flight[j] = flight[--pending];
+    }
+    close(fd);
+    pthread_mutex_lock(&cl->lock);
+    for (uint32 b = 0; b < HIST_BUCKETS; b++) {
+        cl->latency.count[b] += h->count[b];
+    }
+    cl->latency.total += h->total;
+    cl->latency.max = h->max > cl->latency.max ? h->max : cl->latency.max;
+    cl->wrong += wrong;
+    cl->errors += errors;
+    pthread_mutex_unlock(&cl->lock);
+    free(h);
+    free(flight);
+    return NULL;
+}
+
+/// \brief Adds the inputs of a test vector file, or the file as one raw input
+static int add_sources(struct Client *cl, const char *path) {
+    struct TestVec *tv = malloc(sizeof(struct TestVec));
+    int ret = testvec_open(tv, path);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret == 0) {
+        // kept mapped until the end
+        cl->sources = realloc(cl->sources, (cl->source_count + tv->header->count) * sizeof(struct Source));
+        for (uint64 i = 0; i < tv->header->count; i++) {
+            cl->sources[cl->source_count++] = (struct Source){ testvec_input(tv, i), tv->header->input_bytes,
+                testvec_record(tv, i)->expected, true };
+        }
+        return 0;
+    }
+    free(tv);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8 *bits = malloc(size > 0 ? size : 1);
+    if (size <= 0 || fread(bits, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        fclose(f);
+        free(bits);
+        return -1;
+    }
+    fclose(f);
+    cl->sources = realloc(cl->sources, (cl->source_count + 1) * sizeof(struct Source));
+    cl->sources[cl->source_count++] = (struct Source){ bits, (uint32)size, 0, false };
+    return 0;
+}
+
+static int client(struct Client *cl, char **paths, int count, int connections) {
+    for (int i = 0; i < count; i++) {
+        if (add_sources(cl, paths[i]) != 0) {
+            return 2;
+        }
+    }
+    if (cl->source_count == 0) {
+        fprintf(stderr, "no inputs\n");
+        return 2;
+    }
+    if (cl->requests == 0) {
+        cl->requests = cl->source_count;
+    }
+    pthread_mutex_init(&cl->lock, NULL);
+    pthread_t *threads = malloc(connections * sizeof(pthread_t));
+    double t0 = now();
+    for (int i = 0; i < connections; i++) {
+        pthread_create(&threads[i], NULL, client_thread, cl);
+    }
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double t = now() - t0;
+    free(threads);
+    const struct Histogram *h = &cl->latency;
+    printf("%llu requests in %.3f s (%.0f/s) over %d connections, %u in flight each; latency p50 %.1f us, "
+        "p99 %.1f us, max %.1f us; %llu wrong return_values, %llu errors\n", (unsigned long long)h->total, t,
+        h->total / t, connections, cl->depth, hist_percentile(h, 0.50), hist_percentile(h, 0.99), h->max * 1e-3,
+        (unsigned long long)cl->wrong, (unsigned long long)cl->errors);
+    return cl->wrong == 0 && cl->errors == 0 && h->total == cl->requests ? 0 : 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j threads] [-s socket] [-r seconds] circuit\n"
+        "       %s -w circuit.bin circuit.txt\n"
+        "       %s -C [-s socket] [-c connections] [-d depth] [-n requests] inputs.vec|input.bin...\n",
+        name, name, name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = VERIFYD_SOCKET, *binary = NULL;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN), connections = 1;
+    bool is_client = false;
+    struct Client cl = { .depth = 1 };
+    int opt;
+    while ((opt = getopt(argc, argv, "Cc:d:j:n:r:s:w:")) != -1) {
+        switch (opt) {
+        case 'C': is_client = true; break;
+        case 'c': connections = atoi(optarg); break;
+        case 'd': cl.depth = (uint32)strtoul(optarg, NULL, 0); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'n': cl.requests = strtoull(optarg, NULL, 0); break;
+        case 'r': report_interval = strtod(optarg, NULL); break;
+        case 's': socket_path = optarg; break;
+        case 'w': binary = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind == argc || threads < 1 || connections < 1 || cl.depth < 1 || report_interval <= 0) {
+        usage(argv[0]);
+    }
+    if (is_client) {
+        cl.socket_path = socket_path;
+        return client(&cl, argv + optind, argc - optind, connections);
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+    }
+    if (binary != NULL) {
+        struct BristolCircuit c;
+        if (bristol_load(&c, argv[optind]) != 0 || bristol_write(&c, binary) != 0) {
+            return 2;
+        }
+        fprintf(stderr, "wrote %s: %u gates, %u wires\n", binary, c.gates, c.wires);
+        bristol_free(&c);
+        return 0;
+    }
+    return serve(argv[optind], socket_path, threads);
+}